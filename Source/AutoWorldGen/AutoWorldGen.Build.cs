@@ -15,11 +15,15 @@ public class AutoWorldGen : ModuleRules
 			"InputCore",
 			"EnhancedInput",
             "Landscape",
+			"ProceduralMeshComponent",
 			"AssetTools",
 			"UnrealEd",
 			"EditorScriptingUtilities",
 			"Json",
             "JsonUtilities"
         });
+
+		// Set to 1 to run terrain generation in double instead of float precision
+		PublicDefinitions.Add("AUTOWORLDGEN_DOUBLE_PRECISION=0");
 	}
 }
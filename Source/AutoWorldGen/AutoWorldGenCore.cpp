@@ -1,4 +1,6 @@
 #include "AutoWorldGenCore.h"
+#include "BiomePreset.h"
+#include "TerrainTileSink.h"
 
 #include "LandscapeStreamingProxy.h"
 #include "LandscapeInfo.h"
@@ -7,8 +9,78 @@
 #include "Editor.h"
 #include "EditorAssetLibrary.h"
 #include "FileHelpers.h"
+#include "Misc/AsyncTaskNotification.h"
 #include "UObject/SavePackage.h"
 
+DECLARE_CYCLE_STAT(TEXT("Quantize"), STAT_AutoWorldGen_Quantize, STATGROUP_AutoWorldGen);
+DECLARE_CYCLE_STAT(TEXT("Landscape Import"), STAT_AutoWorldGen_Import, STATGROUP_AutoWorldGen);
+DECLARE_CYCLE_STAT(TEXT("Landscape PostEditChange"), STAT_AutoWorldGen_PostEditChange, STATGROUP_AutoWorldGen);
+
+namespace
+{
+    TArray<uint16> QuantizeHeights(const FTerrainGenerator& Generator, const VMatrix& Heights, const FLandscapeLayout& Layout,
+        const EHeightResampling Resampling, const FHeightQuantization& Quantization, FTerrainGenerationStats* Stats)
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::Quantize);
+        SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_Quantize);
+        FTerrainStageScope StageScope(Stats, ETerrainStage::Quantize);
+
+        const int32 HeightmapSize = Layout.GetHeightmapSize();
+        TArray<uint16> HeightData;
+        HeightData.SetNumUninitialized(HeightmapSize * HeightmapSize);
+        StageScope.AddAllocatedBytes(HeightData.GetAllocatedSize());
+
+        Generator.Quantize(Heights, HeightmapSize, Resampling, Quantization, HeightData.GetData());
+        return HeightData;
+    }
+
+    void WriteHeightfieldCache(const FString& FilePath, const FHeightfieldCacheHeader& Header, TArrayView<const uint16> HeightData)
+    {
+        FHeightfieldCacheSink Sink(FilePath, Header);
+        if (!Sink.WriteSamples(FIntRect(0, 0, Header.Width, Header.Height), HeightData.GetData()) || !Sink.Finish())
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Failed to write the heightfield cache %s."), *FilePath);
+        }
+    }
+
+    FText GetProgressText(const FTerrainGenerationProgress& Progress, const TArray<FBiome>& Biomes)
+    {
+        const int32 Percent = FMath::FloorToInt32(Progress.GetFraction() * 100.0);
+        if (Progress.GetLastStage() == ETerrainStage::Erosion)
+        {
+            return FText::FromString(FString::Printf(TEXT("%d%%, erosion"), Percent));
+        }
+
+        const int32 BiomeIndex = Progress.GetLastBiome();
+        if (!Biomes.IsValidIndex(BiomeIndex))
+        {
+            return FText::FromString(FString::Printf(TEXT("%d%%"), Percent));
+        }
+
+        const FBiome& Biome = Biomes[BiomeIndex];
+        if (Progress.GetLastStage() == ETerrainStage::Blend)
+        {
+            return FText::FromString(FString::Printf(TEXT("%d%%, blended %s"), Percent, *Biome.Name));
+        }
+        if (Progress.GetLastOctave() != INDEX_NONE)
+        {
+            return FText::FromString(FString::Printf(TEXT("%d%%, %s octave %d of %d"), Percent, *Biome.Name, Progress.GetLastOctave() + 1, Biome.Octaves));
+        }
+        return FText::FromString(FString::Printf(TEXT("%d%%, %s noise"), Percent, *Biome.Name));
+    }
+}
+
+bool AAutoWorldGenCore::FGenerationSettings::HasSameLayout(const FGenerationSettings& Other) const
+{
+    return WorldSize == Other.WorldSize
+        && TileSize == Other.TileSize
+        && BiomeWeightEpsilon == Other.BiomeWeightEpsilon
+        && HeightQuantization == Other.HeightQuantization
+        && Resampling == Other.Resampling
+        && Layout == Other.Layout
+        && Erosion == Other.Erosion;
+}
+
 AAutoWorldGenCore::AAutoWorldGenCore()
 {
     PrimaryActorTick.bCanEverTick = false;
@@ -18,15 +90,35 @@ AAutoWorldGenCore::AAutoWorldGenCore()
 
     bAutoGenerate = false;
     bOptimalWorldSize = false;
+    LayoutBudget = FLandscapeLayoutBudget();
+    bPreviewWhileEditing = false;
+    PreviewStride = 4;
+    PreviewRefineDelay = 1.0f;
     WorldSize = 512;
     TileSize = 128;
+    NumThreads = 0;
+    BiomeWeightEpsilon = 1.0e-5;
+    HeightQuantization = FHeightQuantization();
+    Resampling = EHeightResampling::None;
+    Erosion = FTerrainErosionSettings();
+    bGenerateAtRuntime = false;
+    RuntimeStreaming = CreateDefaultSubobject<UTerrainStreamingComponent>(TEXT("RuntimeStreaming"));
+    bStreamGeneration = false;
+    StreamTarget = ETerrainStreamTarget::Landscape;
+    StreamFilePath = FString();
+    StreamingMemoryBudgetMB = 4096;
+    bUseHeightfieldCache = true;
+    HeightfieldCachePath = FString();
+    OctaveCacheBudgetMB = 1024;
     Biomes = TArray<FBiome>();
 
-    CurrentWorldSize = 0;
-    CurrentTileSize = 0;
-    CurrentBiomes = TArray<FBiome>();
+    CurrentSettings = FGenerationSettings();
+    LayerCache = MakeShared<FTerrainLayerCache>();
+    PreviewLayerCache = MakeShared<FTerrainLayerCache>();
+    OctaveCache = MakeShared<FOctaveLayerCache>();
 
     GeneratedLandscape = nullptr;
+    PreviewLandscape = nullptr;
 }
 
 void AAutoWorldGenCore::OnConstruction(const FTransform& Transform)
@@ -42,441 +134,704 @@ void AAutoWorldGenCore::OnConstruction(const FTransform& Transform)
         LoadBiomesFromJson(FPaths::ProjectContentDir() + TEXT("Biomes.json"));
     }
 
-    if (!bAutoGenerate)
+    // Runtime cells would sit on top of the landscape
+    if (!bAutoGenerate || bGenerateAtRuntime)
     {
         return;
     }
 
+    // Generate exactly the samples of the solved layout, none are dropped or stretched
     if (bOptimalWorldSize)
     {
-        WorldSize = 8129;
+        WorldSize = FLandscapeLayout::Solve(WorldSize - 1, LayoutBudget).GetHeightmapSize();
+    }
+
+    const FGenerationSettings Settings = GetGenerationSettings();
+    if ((ActiveGeneration.IsValid() && ActiveGeneration->Settings == Settings) || (PendingRefinement.IsSet() && PendingRefinement.GetValue() == Settings))
+    {
+        return;
+    }
+
+    // An edit supersedes the generation in flight, which has not touched the landscape yet
+    StopGeneration();
+
+    if (Settings == CurrentSettings || Biomes.Num() == 0)
+    {
+        RemovePreviewLandscape();
+        return;
     }
 
-    if (!bIsChanged())
+    // Streamed generation writes the landscape as it goes, there is nothing to preview
+    if (bPreviewWhileEditing && !bStreamGeneration)
     {
+        RefineTime = FPlatformTime::Seconds() + PreviewRefineDelay;
+        StartGeneration(Settings, false, FMath::Max(PreviewStride, 2));
         return;
     }
 
-    VMatrix Heights = GenerateTerrainNoiseMap();
+    // The existing landscape can only be patched when its layout stays the same. A new weight epsilon
+    // moves every biome's support and a new quantization changes every sample, so they need a full rebuild as well.
+    const bool bSameLayout = Settings.CanPatch(CurrentSettings);
 
-    CreateLandscape(Heights);
+    GenerateTerrain(Settings, bSameLayout);
 }
 
-bool AAutoWorldGenCore::SaveBiomesToJson(const FString& FilePath)
+void AAutoWorldGenCore::BeginPlay()
 {
-    TSharedPtr<FJsonObject> RootObject = MakeShareable(new FJsonObject);
+    Super::BeginPlay();
 
-    TArray<TSharedPtr<FJsonValue>> BiomeArray;
-    for (const FBiome& Biome : Biomes)
+    if (!bGenerateAtRuntime || Biomes.Num() == 0)
     {
-        TSharedPtr<FJsonObject> BiomeObject = MakeShareable(new FJsonObject);
+        return;
+    }
 
-        // Serialize Biome properties
-        BiomeObject->SetStringField(TEXT("Name"), Biome.Name);
-        BiomeObject->SetBoolField(TEXT("bGradientDetailReduction"), Biome.bGradientDetailReduction);
-        BiomeObject->SetNumberField(TEXT("GradientDetailReductionSpeed"), Biome.GradientDetailReductionSpeed);
-        BiomeObject->SetNumberField(TEXT("RangeMax"), Biome.Range.X);
-        BiomeObject->SetNumberField(TEXT("RangeMin"), Biome.Range.Y);
-        BiomeObject->SetNumberField(TEXT("Seed"), Biome.Seed);
-        BiomeObject->SetNumberField(TEXT("Octaves"), Biome.Octaves);
-        BiomeObject->SetNumberField(TEXT("Persistence"), Biome.Persistence);
-        BiomeObject->SetNumberField(TEXT("Lacunarity"), Biome.Lacunarity);
-        BiomeObject->SetNumberField(TEXT("NoiseScale"), Biome.NoiseScale);
-        BiomeObject->SetNumberField(TEXT("a"), Biome.a);
-        BiomeObject->SetNumberField(TEXT("s"), Biome.s);
-        BiomeObject->SetNumberField(TEXT("k"), Biome.k);
-        BiomeObject->SetNumberField(TEXT("OriginX"), Biome.Origin.X);
-        BiomeObject->SetNumberField(TEXT("OriginY"), Biome.Origin.Y);
+    FTerrainCellSettings Settings;
+    Settings.Biomes = Biomes;
+    Settings.WorldSize = WorldSize;
+    Settings.WeightEpsilon = BiomeWeightEpsilon;
+    Settings.TileSize = TileSize;
+    Settings.HeightOffset = HeightQuantization.Offset;
+    RuntimeStreaming->StartStreaming(Settings);
+}
 
-        // Add BiomeObject to BiomeArray
-        BiomeArray.Add(MakeShareable(new FJsonValueObject(BiomeObject)));
-    }
+void AAutoWorldGenCore::Destroyed()
+{
+    CancelGeneration();
+    Super::Destroyed();
+}
+
+void AAutoWorldGenCore::BeginDestroy()
+{
+    // The world may be gone already, the preview is transient and goes with it
+    StopGeneration();
+    Super::BeginDestroy();
+}
 
-    RootObject->SetArrayField(TEXT("Biomes"), BiomeArray);
+void AAutoWorldGenCore::GenerateTerrain(const FGenerationSettings& Settings, const bool bSameLayout)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::GenerateTerrain);
+
+    LastGenerationStats = FTerrainGenerationStats();
+    const double StartTime = FPlatformTime::Seconds();
 
-    // Serialize RootObject to a JSON formatted string
-    FString OutputString;
-    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&OutputString);
-    if (FJsonSerializer::Serialize(RootObject.ToSharedRef(), Writer))
+    // A landscape that is not patched is rebuilt from scratch, which the cache can skip.
+    // Streamed generation writes into the landscape band by band, which has to happen on the game thread.
+    if (bStreamGeneration)
+    {
+        GenerateTerrainStreamed();
+    }
+    else if (bSameLayout || !ImportCachedHeightfield())
     {
-        // Save JSON string to file
-        return FFileHelper::SaveStringToFile(OutputString, *FilePath);
+        StartGeneration(Settings, bSameLayout);
+        return;
     }
 
-    return false;
+    CurrentSettings = Settings;
+    RemovePreviewLandscape();
+    LogGenerationStats(StartTime);
+}
+
+bool AAutoWorldGenCore::SaveBiomesToJson(const FString& FilePath)
+{
+    return BiomePreset::SaveJson(FilePath, Biomes);
 }
 
 bool AAutoWorldGenCore::LoadBiomesFromJson(const FString& FilePath)
 {
-    FString JsonString;
-    if (!FFileHelper::LoadFileToString(JsonString, *FilePath))
+    return BiomePreset::LoadJson(FilePath, Biomes);
+}
+
+bool AAutoWorldGenCore::SaveBiomesToBinary(const FString& FilePath)
+{
+    return BiomePreset::SaveBinary(FilePath, Biomes);
+}
+
+bool AAutoWorldGenCore::LoadBiomesFromBinary(const FString& FilePath)
+{
+    return BiomePreset::LoadBinary(FilePath, Biomes);
+}
+
+AAutoWorldGenCore::FGenerationSettings AAutoWorldGenCore::GetGenerationSettings() const
+{
+    FGenerationSettings Settings;
+    Settings.WorldSize = WorldSize;
+    Settings.TileSize = TileSize;
+    Settings.Biomes = Biomes;
+    Settings.BiomeWeightEpsilon = BiomeWeightEpsilon;
+    Settings.HeightQuantization = HeightQuantization;
+    Settings.Resampling = Resampling;
+    Settings.Layout = GetLandscapeLayout(WorldSize, Resampling);
+    Settings.Erosion = Erosion;
+    return Settings;
+}
+
+void AAutoWorldGenCore::StartGeneration(const FGenerationSettings& Settings, const bool bSameLayout, const int32 SampleStride)
+{
+    const TSharedRef<FActiveGeneration> Generation = MakeShared<FActiveGeneration>();
+    Generation->Settings = Settings;
+    Generation->PreviousBiomes = CurrentSettings.Biomes;
+    Generation->bSameLayout = bSameLayout;
+    Generation->SampleStride = SampleStride;
+    Generation->StartTime = FPlatformTime::Seconds();
+
+    // A preview spans the samples the landscape will cover and is stretched back over them
+    const bool bPreview = SampleStride > 1;
+    const int32 CoveredSamples = FMath::RoundToInt32(Settings.Layout.GetSizeQuads() * Settings.Layout.SampleSpacing);
+    const int32 Size = bPreview ? CoveredSamples / SampleStride + 1 : Settings.WorldSize;
+    const EHeightResampling GenerationResampling = bPreview ? EHeightResampling::Bilinear : Settings.Resampling;
+    Generation->Layout = bPreview ? GetPreviewLayout(Size, SampleStride) : Settings.Layout;
+
+    // Previews come with every edit and are quick, a notification for each would only flicker
+    if (!bPreview)
     {
-        return false;
+        FAsyncTaskNotificationConfig NotificationConfig;
+        NotificationConfig.TitleText = FText::FromString(FString::Printf(TEXT("Generating %dx%d terrain"), Settings.WorldSize, Settings.WorldSize));
+        NotificationConfig.ProgressText = FText::FromString(TEXT("0%"));
+        NotificationConfig.bCanCancel = true;
+        Generation->Notification = MakeUnique<FAsyncTaskNotification>(NotificationConfig);
     }
 
-    TSharedPtr<FJsonObject> RootObject;
-    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+    // The task gets copies of everything it reads, the properties can change while it runs
+    FTerrainGenerator Generator(Settings.Biomes, Settings.WorldSize, NumThreads);
+    Generator.SetWeightEpsilon(Settings.BiomeWeightEpsilon);
+    Generator.SetSampleStride(SampleStride);
+    Generator.SetStats(&Generation->Stats);
+    Generator.SetProgress(&Generation->Progress);
+
+    // Previews are thrown away as soon as the edits stop, they show the heights before erosion
+    FTerrainErosion Eroder(bPreview ? FTerrainErosionSettings() : Settings.Erosion, NumThreads);
+    Eroder.SetStats(&Generation->Stats);
+    Eroder.SetProgress(&Generation->Progress);
+
+    const bool bWriteCache = bUseHeightfieldCache && !bPreview && Settings.Layout.NumComponents > 0;
+    const FString CachePath = GetHeightfieldCachePath();
+    const FHeightfieldCacheHeader CacheHeader = MakeHeightfieldCacheHeader(Settings, Settings.Layout.GetHeightmapSize());
+    const TSharedPtr<FTerrainLayerCache> GenerationLayerCache = bPreview ? PreviewLayerCache : LayerCache;
+
+    // The task holds on to the octave cache, which may be trimmed by a later generation meanwhile
+    OctaveCache->SetMemoryBudget(static_cast<int64>(OctaveCacheBudgetMB) * 1024 * 1024);
+    const TSharedPtr<FOctaveLayerCache> GenerationOctaveCache = OctaveCacheBudgetMB > 0 ? OctaveCache : nullptr;
+    Generator.SetOctaveCache(GenerationOctaveCache.Get());
+
+    TArray<UE::Tasks::FTask, TInlineAllocator<1>> Prerequisites;
+    if (GenerationTask.IsValid())
+    {
+        Prerequisites.Add(GenerationTask);
+    }
 
-    if (FJsonSerializer::Deserialize(Reader, RootObject) && RootObject.IsValid())
+    GenerationTask = UE::Tasks::Launch(TEXT("AutoWorldGen.Generate"), [Generation, Generator, Eroder, GenerationLayerCache, GenerationOctaveCache, Size, GenerationResampling, bWriteCache, CachePath, CacheHeader]()
     {
-        TArray<TSharedPtr<FJsonValue>> BiomeArray = RootObject->GetArrayField(TEXT("Biomes"));
-        Biomes.Empty();
-        for (TSharedPtr<FJsonValue> Value : BiomeArray)
+        const FGenerationSettings& Settings = Generation->Settings;
+        Generation->Heights = Generator.Generate(FIntRect(0, 0, Size, Size), GenerationLayerCache.Get());
+        if (!Eroder.Erode(Generation->Heights))
+        {
+            Generation->Heights.Reset();
+        }
+        if (Generation->Heights.IsEmpty() || Generation->Layout.NumComponents == 0)
         {
-            TSharedPtr<FJsonObject> BiomeObject = Value->AsObject();
-            if (BiomeObject.IsValid())
-            {
-                FBiome Biome;
-
-                // Deserialize Biome properties
-                Biome.Name = BiomeObject->GetStringField(TEXT("Name"));
-                Biome.bGradientDetailReduction = BiomeObject->GetBoolField(TEXT("bGradientDetailReduction"));
-                Biome.GradientDetailReductionSpeed = BiomeObject->GetNumberField(TEXT("GradientDetailReductionSpeed"));
-                Biome.Range.X = BiomeObject->GetNumberField(TEXT("RangeMax"));
-                Biome.Range.Y = BiomeObject->GetNumberField(TEXT("RangeMin"));
-                Biome.Seed = (int32)BiomeObject->GetNumberField(TEXT("Seed"));
-                Biome.Octaves = (uint8)BiomeObject->GetNumberField(TEXT("Octaves"));
-                Biome.Persistence = BiomeObject->GetNumberField(TEXT("Persistence"));
-                Biome.Lacunarity = BiomeObject->GetNumberField(TEXT("Lacunarity"));
-                Biome.NoiseScale = BiomeObject->GetNumberField(TEXT("NoiseScale"));
-                Biome.a = BiomeObject->GetNumberField(TEXT("a"));
-                Biome.s = BiomeObject->GetNumberField(TEXT("s"));
-                Biome.k = BiomeObject->GetNumberField(TEXT("k"));
-                Biome.Origin.X = BiomeObject->GetNumberField(TEXT("OriginX"));
-                Biome.Origin.Y = BiomeObject->GetNumberField(TEXT("OriginY"));
-
-                Biomes.Add(Biome);
-            }
+            return;
         }
 
-        return true;
-    }
+        // The quantized samples go into the cache and into a landscape that is built again. A landscape that
+        // can be patched keeps its heights too, the quantized samples rebuild it when the patch fails.
+        Generation->HeightData = QuantizeHeights(Generator, Generation->Heights, Generation->Layout, GenerationResampling, Settings.HeightQuantization, &Generation->Stats);
+        if (!Generation->bSameLayout)
+        {
+            Generation->Heights.Reset();
+        }
 
-    return false;
+        if (bWriteCache)
+        {
+            WriteHeightfieldCache(CachePath, CacheHeader, Generation->HeightData);
+        }
+    }, Prerequisites, UE::Tasks::ETaskPriority::BackgroundNormal);
+
+    ActiveGeneration = Generation;
+    StartGenerationTicker();
 }
 
-bool AAutoWorldGenCore::bIsChanged()
+bool AAutoWorldGenCore::TickGeneration(float DeltaTime)
 {
-    if (WorldSize == CurrentWorldSize &&
-        TileSize == CurrentTileSize &&
-        Biomes == CurrentBiomes)
+    if (!ActiveGeneration.IsValid())
     {
+        // Between a preview and its refinement, which waits until the edits have stopped for a while
+        if (PendingRefinement.IsSet() && FPlatformTime::Seconds() < RefineTime)
+        {
+            return true;
+        }
+
+        GenerationTickerHandle.Reset();
+        if (PendingRefinement.IsSet())
+        {
+            const FGenerationSettings Settings = PendingRefinement.GetValue();
+            PendingRefinement.Reset();
+            GenerateTerrain(Settings, Settings.CanPatch(CurrentSettings));
+        }
         return false;
     }
 
-    if (Biomes.Num() == 0)
+    const TUniquePtr<FAsyncTaskNotification>& Notification = ActiveGeneration->Notification;
+    if (Notification.IsValid() && Notification->GetPromptAction() == EAsyncTaskNotificationPromptAction::Cancel)
     {
+        GenerationTickerHandle.Reset();
+        CancelGeneration();
         return false;
     }
 
-    CurrentWorldSize = WorldSize;
-    CurrentTileSize = TileSize;
-    CurrentBiomes = Biomes;
+    if (GenerationTask.IsCompleted())
+    {
+        GenerationTickerHandle.Reset();
+        FinishGeneration();
+        return false;
+    }
 
+    if (Notification.IsValid())
+    {
+        Notification->SetProgressText(GetProgressText(ActiveGeneration->Progress, ActiveGeneration->Settings.Biomes));
+    }
     return true;
 }
 
-VMatrix AAutoWorldGenCore::GenerateTerrainNoiseMap()
+void AAutoWorldGenCore::FinishGeneration()
 {
-    TArray<VMatrix> BiomeNoiseMaps;
-    uint8 BiomeNum = Biomes.Num();
-    BiomeNoiseMaps.SetNum(BiomeNum);
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::FinishGeneration);
 
-    for (uint8 i = 0; i < BiomeNum; i++)
+    const TSharedPtr<FActiveGeneration> Generation = MoveTemp(ActiveGeneration);
+    ActiveGeneration.Reset();
+    StopGenerationTicker();
+    if (!Generation.IsValid())
     {
-        const FBiome& Biome = Biomes[i];
-        BiomeNoiseMaps[i] = GetNoiseMap(
-			Biome.bGradientDetailReduction,
-			Biome.GradientDetailReductionSpeed,
-            WorldSize,
-            Biome.Range,
-            Biome.Seed,
-            Biome.Octaves,
-            Biome.Persistence,
-            Biome.Lacunarity,
-            Biome.NoiseScale
-        );
+        return;
     }
 
-    TArray<VMatrix> BiomeDistances;
-    BiomeDistances.SetNum(BiomeNum);
-    for (uint8 i = 0; i < BiomeNum; i++)
+    LastGenerationStats = Generation->Stats;
+
+    // The landscape keeps the current settings until the preview is refined
+    if (Generation->SampleStride > 1)
     {
-        const FBiome& Biome = Biomes[i];
-        BiomeDistances[i] = GetDistancesFromCenter(
-            WorldSize,
-            FVector2D(Biome.Origin.X + WorldSize / 2, Biome.Origin.Y + WorldSize / 2)
-        );
+        if (Generation->HeightData.Num() > 0)
+        {
+            ShowPreviewLandscape(Generation->Layout, MoveTemp(Generation->HeightData));
+        }
 
-        BiomeDistances[i] = Subtract(1, Fade(BiomeDistances[i], Biome.a, Biome.s, Biome.k));
+        PendingRefinement = Generation->Settings;
+        StartGenerationTicker();
+        LogGenerationStats(Generation->StartTime);
+        return;
     }
 
-    if (BiomeNum > 1)
+    CurrentSettings = Generation->Settings;
+
+    // The task already quantized the heights and wrote the cache, only the landscape is touched here
+    const bool bPatched = Generation->bSameLayout && UpdateLandscape(Generation->Heights, Generation->Settings, Generation->PreviousBiomes);
+    Generation->Heights.Reset();
+    if (!bPatched)
     {
-        BiomeDistances[BiomeNum - 1] = Subtract(1, BiomeDistances[BiomeNum - 2]);
+        // Also when the landscape could not be patched after all
+        if (Generation->Settings.Layout.NumComponents > 0)
+        {
+            ImportLandscape(Generation->Settings.Layout, MoveTemp(Generation->HeightData));
+        }
+        else
+        {
+            UE_LOG(LogTemp, Warning, TEXT("WorldSize is too small for a single landscape component."));
+        }
     }
-    for (int8 i = BiomeNum - 2; i > 0; i--)
+
+    RemovePreviewLandscape();
+    Generation->Notification->SetComplete(FText::FromString(TEXT("Generated terrain")), FText::GetEmpty(), GeneratedLandscape != nullptr);
+    LogGenerationStats(Generation->StartTime);
+}
+
+void AAutoWorldGenCore::CancelGeneration()
+{
+    StopGeneration();
+
+    // The landscape goes back to the settings it was last generated with
+    RemovePreviewLandscape();
+}
+
+void AAutoWorldGenCore::StopGeneration()
+{
+    StopGenerationTicker();
+    PendingRefinement.Reset();
+
+    if (!ActiveGeneration.IsValid())
     {
-        BiomeDistances[i] = Subtract(BiomeDistances[i], BiomeDistances[i - 1]);
+        return;
     }
 
-    for (uint8 i = 0; i < BiomeNum; i++)
+    // The task stops at its next row or octave and drops what it has, the next generation waits for it
+    ActiveGeneration->Progress.Cancel();
+    if (ActiveGeneration->Notification.IsValid())
     {
-        BiomeNoiseMaps[i] = Multiply(BiomeNoiseMaps[i], BiomeDistances[i]);
+        ActiveGeneration->Notification->SetComplete(FText::FromString(TEXT("Terrain generation cancelled")), FText::GetEmpty(), false);
     }
+    ActiveGeneration.Reset();
+}
 
-    VMatrix Heights = BiomeNoiseMaps[0];
-    for (uint8 i = 1; i < BiomeNum; i++)
+void AAutoWorldGenCore::StartGenerationTicker()
+{
+    StopGenerationTicker();
+    GenerationTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &AAutoWorldGenCore::TickGeneration), 0.1f);
+}
+
+void AAutoWorldGenCore::StopGenerationTicker()
+{
+    if (GenerationTickerHandle.IsValid())
     {
-        Heights = Add(Heights, BiomeNoiseMaps[i]);
+        FTSTicker::GetCoreTicker().RemoveTicker(GenerationTickerHandle);
+        GenerationTickerHandle.Reset();
     }
+}
+
+void AAutoWorldGenCore::LogGenerationStats(const double StartTime)
+{
+    LastGenerationStats.TotalMilliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+    UE_LOG(LogTemp, Display, TEXT("%s"), *LastGenerationStats.ToString());
 
-    return Heights;
+    const FOctaveLayerCacheStats OctaveStats = OctaveCache->GetStats();
+    if (OctaveStats.Hits + OctaveStats.Misses > 0)
+    {
+        UE_LOG(LogTemp, Display, TEXT("Octave cache: %lld hits, %lld misses, %lld evicted, %d layers in %.1f MB."),
+            OctaveStats.Hits, OctaveStats.Misses, OctaveStats.Evictions, OctaveStats.NumLayers, OctaveStats.AllocatedBytes / (1024.0 * 1024.0));
+    }
 }
 
-void AAutoWorldGenCore::CreateLandscape(const VMatrix& Heights)
+void AAutoWorldGenCore::GenerateTerrainStreamed()
 {
-#if WITH_EDITOR
-    // Delete existing landscape if it exists  
-    if (GeneratedLandscape && !GeneratedLandscape->IsPendingKillPending())
+    // Bands are written as they are generated, so there is no whole heightfield to resample
+    const FLandscapeLayout Layout = GetLandscapeLayout(WorldSize, EHeightResampling::None);
+    if (Layout.NumComponents == 0)
     {
-        GetWorld()->DestroyActor(GeneratedLandscape);
-        GeneratedLandscape = nullptr;
+        UE_LOG(LogTemp, Warning, TEXT("WorldSize is too small for a single landscape component."));
+        return;
+    }
+
+    // Only the samples that end up in the landscape are generated
+    const int32 HeightmapSize = Layout.GetHeightmapSize();
+    const FIntPoint Size(HeightmapSize, HeightmapSize);
+    const int64 MemoryBudget = static_cast<int64>(StreamingMemoryBudgetMB) * 1024 * 1024;
+    if (Erosion.IsEnabled())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Erosion needs the whole heightfield at once and is skipped while streaming."));
     }
 
-    // Early exit if Heights is empty
-    const int32 TotalRows = Heights.Num();
-    if (TotalRows == 0)
+    FTerrainGenerator Generator(Biomes, WorldSize, NumThreads);
+    Generator.SetStats(&LastGenerationStats);
+    Generator.SetWeightEpsilon(BiomeWeightEpsilon);
+
+    if (StreamTarget == ETerrainStreamTarget::RawFile)
     {
-        UE_LOG(LogTemp, Warning, TEXT("Heights array is empty."));
+        const FString FilePath = StreamFilePath.IsEmpty()
+            ? FPaths::ProjectSavedDir() / TEXT("AutoWorldGen") / TEXT("Heightmap.r16")
+            : StreamFilePath;
+
+        FRawHeightmapSink Sink(FilePath, Size);
+        Sink.SetQuantization(HeightQuantization);
+        if (Sink.IsValid() && Generator.GenerateStreamed(Size, MemoryBudget, Layout.GetComponentSizeQuads(), Sink))
+        {
+            UE_LOG(LogTemp, Display, TEXT("Wrote %dx%d heightmap to %s."), Size.X, Size.Y, *FilePath);
+        }
         return;
     }
-    const int32 TotalCols = Heights[0].Num();
-    if (TotalCols == 0)
+
+#if WITH_EDITOR
+    // Start from a flat landscape and fill it one band of components at a time
+    TArray<uint16> FlatHeightData;
+    FlatHeightData.Init(32768, HeightmapSize * HeightmapSize);
+    ImportLandscape(Layout, MoveTemp(FlatHeightData));
+    if (!GeneratedLandscape)
     {
-        UE_LOG(LogTemp, Warning, TEXT("Heights[0] array is empty."));
         return;
     }
 
-    // Parameters for landscape
-    int32 QuadsPerSection;
-    int32 SectionsPerComponent;
+    const int32 HalfSize = Layout.GetSizeQuads() / 2;
+    FLandscapeHeightSink Sink(GeneratedLandscape, FIntPoint(-HalfSize, -HalfSize));
+    Sink.SetQuantization(HeightQuantization);
+    Generator.GenerateStreamed(Size, MemoryBudget, Layout.GetComponentSizeQuads(), Sink);
+
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::PostEditChange);
+        SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_PostEditChange);
+        FTerrainStageScope StageScope(&LastGenerationStats, ETerrainStage::PostEditChange);
+        GeneratedLandscape->PostEditChange();
+    }
+#endif
+}
+
+FLandscapeLayout AAutoWorldGenCore::GetLandscapeLayout(const int32 Size, const EHeightResampling InResampling) const
+{
+    FLandscapeLayout Layout;
     if (bOptimalWorldSize)
     {
-        QuadsPerSection = 127;
-        SectionsPerComponent = 2; // 2x2
+        // Only the section layout is taken, the component count below fits it to Size
+        const FLandscapeLayout Solved = FLandscapeLayout::Solve(Size - 1, LayoutBudget);
+        Layout.QuadsPerSection = Solved.QuadsPerSection;
+        Layout.SectionsPerComponent = Solved.SectionsPerComponent;
     }
     else
     {
-        QuadsPerSection = 63;
-        SectionsPerComponent = 1;
+        Layout.QuadsPerSection = 63;
+        Layout.SectionsPerComponent = 1;
     }
-    const double Scale = TileSize;
-    const int32 ComponentSizeQuads = QuadsPerSection * SectionsPerComponent;
 
     // Calculate the number of components
-    const int32 NumComponentsX = FMath::FloorToInt(static_cast<double>(TotalCols - 1) / ComponentSizeQuads);
-    const int32 NumComponentsY = FMath::FloorToInt(static_cast<double>(TotalRows - 1) / ComponentSizeQuads);
-
-    const int32 Size = NumComponentsX * ComponentSizeQuads;
-    const int32 HalfSize = Size / 2;
-    const FVector LandscapeLocation = FVector(0, 0, 0);
-
-    // Ensure heightmap size matches required size
-    const int32 HeightmapSizeX = NumComponentsX * ComponentSizeQuads + 1;
-    const int32 HeightmapSizeY = NumComponentsY * ComponentSizeQuads + 1;
+    const double NumComponents = static_cast<double>(Size - 1) / Layout.GetComponentSizeQuads();
+    if (InResampling == EHeightResampling::None || Size < 2)
+    {
+        Layout.NumComponents = FMath::Max(0, FMath::FloorToInt(NumComponents));
+        return Layout;
+    }
 
-    // Create the main Landscape Actor
-    GeneratedLandscape = GetWorld()->SpawnActor<ALandscape>();
-    GeneratedLandscape->SetActorLocation(LandscapeLocation);
-    GeneratedLandscape->SetActorScale3D(FVector(Scale));
+    // Resampled heights can land on the nearest whole number of components, rounding up as well as down
+    Layout.NumComponents = FMath::Max(1, FMath::RoundToInt(NumComponents));
+    Layout.SampleSpacing = static_cast<double>(Size - 1) / Layout.GetSizeQuads();
 
-    // Prepare height data
-    TArray<uint16> HeightData;
-    HeightData.SetNumZeroed(HeightmapSizeX * HeightmapSizeY);
+    return Layout;
+}
 
-    for (int32 y = 0; y < HeightmapSizeY; y++)
+bool AAutoWorldGenCore::UpdateLandscape(const VMatrix& Heights, const FGenerationSettings& Settings, const TArray<FBiome>& PreviousBiomes)
+{
+#if WITH_EDITOR
+    if (!GeneratedLandscape || GeneratedLandscape->IsPendingKillPending() || !GeneratedLandscape->GetLandscapeInfo() || Heights.IsEmpty())
     {
-        for (int32 x = 0; x < HeightmapSizeX; x++)
-        {
-            double HeightValue = Heights[y][x] - 256;
-            const uint16 HeightUint16 = FMath::Clamp(static_cast<int32>(HeightValue * 128.0f + 32768.0f), 0, 65535);
-            HeightData[y * HeightmapSizeX + x] = HeightUint16;
-        }
+        return false;
     }
 
-    // Generate a new GUID for the landscape
-    FGuid LandscapeGuid = FGuid::NewGuid();
-    GeneratedLandscape->SetLandscapeGuid(LandscapeGuid);
+    // A change to one biome moves every resampled sample near it, resampled landscapes are built again
+    const FLandscapeLayout Layout = GetLandscapeLayout(FMath::Min(Heights.GetWidth(), Heights.GetHeight()), Settings.Resampling);
+    const int32 ComponentSize = Layout.GetComponentSizeQuads();
+    if (Layout.NumComponents == 0 || Layout.SampleSpacing != 1.0 || GeneratedLandscape->ComponentSizeQuads != ComponentSize)
+    {
+        return false;
+    }
 
-    // Prepare HeightMapData with default FGuid() key
-    TMap<FGuid, TArray<uint16>> HeightMapData;
-    HeightMapData.Add(FGuid(), HeightData); // Use default FGuid() as key
+    const int32 HeightmapSize = Layout.GetHeightmapSize();
+    FTerrainGenerator Generator(Settings.Biomes, Settings.WorldSize, NumThreads);
+    Generator.SetWeightEpsilon(Settings.BiomeWeightEpsilon);
+    FIntRect Region = Generator.GetChangedRegion(PreviousBiomes, FIntRect(0, 0, HeightmapSize, HeightmapSize), Settings.HeightQuantization);
+    if (Region.IsEmpty())
+    {
+        UE_LOG(LogTemp, Log, TEXT("Biome changes do not reach the landscape."));
+        return true;
+    }
 
-    // Prepare MaterialLayerMap
-    TMap<FGuid, TArray<FLandscapeImportLayerInfo>> MaterialLayerMap;
+    // Grow the region to whole components, neighbouring components share their border vertices
+    Region.Min.X = Region.Min.X / ComponentSize * ComponentSize;
+    Region.Min.Y = Region.Min.Y / ComponentSize * ComponentSize;
+    Region.Max.X = FMath::Min(FMath::DivideAndRoundUp(Region.Max.X, ComponentSize) * ComponentSize + 1, HeightmapSize);
+    Region.Max.Y = FMath::Min(FMath::DivideAndRoundUp(Region.Max.Y, ComponentSize) * ComponentSize + 1, HeightmapSize);
 
-    // Create layer info with default FGuid()
-    FLandscapeImportLayerInfo LayerInfo;
-    LayerInfo.LayerName = FName("Layer_0"); // You can set an appropriate name
-    LayerInfo.LayerData.SetNumZeroed(HeightmapSizeX * HeightmapSizeY);
+    const int32 HalfSize = Layout.GetSizeQuads() / 2;
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::Import);
+        SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_Import);
+        FTerrainStageScope StageScope(&LastGenerationStats, ETerrainStage::Import);
 
-    // Add the layer info to MaterialLayerMap with default FGuid() key
-    MaterialLayerMap.Add(FGuid(), { LayerInfo });
+        FLandscapeHeightSink Sink(GeneratedLandscape, FIntPoint(-HalfSize, -HalfSize));
+        Sink.SetQuantization(Settings.HeightQuantization);
+        if (!Sink.WriteTile(Region, Heights.Crop(Region)))
+        {
+            return false;
+        }
+    }
 
-    TArray<FLandscapeLayer> NoImportLayers;
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::PostEditChange);
+        SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_PostEditChange);
+        FTerrainStageScope StageScope(&LastGenerationStats, ETerrainStage::PostEditChange);
+        GeneratedLandscape->PostEditChange();
+    }
 
-    // Call the Import method
-    GeneratedLandscape->Import(
-        LandscapeGuid,
-        -HalfSize,
-        -HalfSize,
-        Size - HalfSize,
-        Size - HalfSize,
-        SectionsPerComponent,
-        QuadsPerSection,
-        HeightMapData,
-        TEXT("GeneratedHeightmap"),
-        MaterialLayerMap,
-        ELandscapeImportAlphamapType::Layered,
-        TArrayView<const FLandscapeLayer>(NoImportLayers)
-    );
-
-    GeneratedLandscape->PostEditChange();
+    const int32 NumUpdated = ((Region.Width() - 1) / ComponentSize) * ((Region.Height() - 1) / ComponentSize);
+    UE_LOG(LogTemp, Log, TEXT("Updated %d of %d landscape components."), NumUpdated, Layout.NumComponents * Layout.NumComponents);
+    return true;
+#else
+    return false;
 #endif
 }
 
-VMatrix AAutoWorldGenCore::GetNoiseMap(
-    const bool bGradientDetailReduction,
-    const double GradientDetailReductionSpeed,
-    const uint16 Size,
-    const FVector2D Range,
-    int32 Seed,
-    const uint8 Octaves,
-    const double Persistence,
-    const double Lacunarity,
-    const double NoiseScale
-) {
-    VMatrix NoiseMap;
-    VMatrix GradientMap;
-    NoiseMap.SetNum(Size);
-    if (bGradientDetailReduction)
-    {
-        GradientMap.SetNum(Size);
-    }
-    for (uint16 y = 0; y < Size; ++y)
-    {
-        NoiseMap[y].SetNum(Size);
-        if (bGradientDetailReduction)
-        {
-            GradientMap[y].SetNum(Size);
-            for (uint16 x = 0; x < Size; ++x)
-            {
-                GradientMap[y][x] = 1.0;
-            }
-        }
+FLandscapeLayout AAutoWorldGenCore::GetPreviewLayout(const int32 PreviewSize, const int32 SampleStride) const
+{
+    // Stretched onto whole components like resampled heights, each quad then covers SampleStride times more of the world
+    FLandscapeLayout Layout = GetLandscapeLayout(PreviewSize, EHeightResampling::Bilinear);
+    Layout.SampleSpacing *= SampleStride;
+    return Layout;
+}
+
+void AAutoWorldGenCore::ShowPreviewLandscape(const FLandscapeLayout& Layout, TArray<uint16>&& HeightData)
+{
+#if WITH_EDITOR
+    if (PreviewLandscape && !PreviewLandscape->IsPendingKillPending())
+    {
+        GetWorld()->DestroyActor(PreviewLandscape);
     }
 
-    double MaxNoiseHeight = 0.0f;
-    TArray<FVector2D> OctaveOffsets;
-    OctaveOffsets.SetNum(Octaves);
-    for (uint8 o = 0; o < Octaves; ++o)
+    // Never saved with the level, the full resolution replaces it
+    PreviewLandscape = SpawnLandscape(Layout, MoveTemp(HeightData), RF_Transient);
+    if (GeneratedLandscape)
     {
-        MaxNoiseHeight += FMath::Pow(Persistence, o);
+        GeneratedLandscape->SetIsTemporarilyHiddenInEditor(true);
+    }
+#endif
+}
 
-        FRandomStream RandomStream(Seed++);
-        double OffsetX = RandomStream.FRandRange(-100000.0f, 100000.0f);
-        double OffsetY = RandomStream.FRandRange(-100000.0f, 100000.0f);
-        OctaveOffsets[o] = FVector2D(OffsetX, OffsetY);
+void AAutoWorldGenCore::RemovePreviewLandscape()
+{
+#if WITH_EDITOR
+    if (PreviewLandscape && !PreviewLandscape->IsPendingKillPending())
+    {
+        GetWorld()->DestroyActor(PreviewLandscape);
     }
+    PreviewLandscape = nullptr;
 
-    double Amplitude = 1.0f;
-    double FrequencyAcc = 1.0f;
-    // Apply multiple octaves
-    for (uint8 o = 0; o < Octaves; ++o)
+    if (GeneratedLandscape)
     {
-        // Loop through each point in the noise map
-        for (uint16 y = 0; y < Size; ++y)
-        {
-            for (uint16 x = 0; x < Size; ++x)
-            {
-                // Generate sample points
-                const double SampleX = x * FrequencyAcc * NoiseScale + OctaveOffsets[o].X;
-                const double SampleY = y * FrequencyAcc * NoiseScale + OctaveOffsets[o].Y;
-
-                // Get Perlin noise value (returns value in range [-1, 1])
-                double PerlinValue = FMath::PerlinNoise2D(FVector2D(SampleX, SampleY)) * Amplitude;
-
-                // If enabled, reduce higher details based on gradient
-                if (bGradientDetailReduction)
-                {
-                    double DetailFactor = GradientMap[y][x];
-                    PerlinValue *= DetailFactor;
-
-					const double CurrentHeight = NoiseMap[y][x];
-                    double dx = PerlinValue + CurrentHeight;
-                    double dy = PerlinValue + CurrentHeight;
-
-                    // Approximate gradient from neighboring values
-                    if (x > 0)
-                    {
-                        dx = PerlinValue - NoiseMap[y][x - 1];
-                    }
-                    if (y > 0)
-                    {
-                        dy = PerlinValue - NoiseMap[y - 1][x];
-                    }
-
-                    const double GradLen = FMath::Sqrt(dx * dx + dy * dy);
-                    const double NewDetailFactor = 1.0 / (1.0 + GradientDetailReductionSpeed * GradLen);
-                    DetailFactor = DetailFactor * (1 - Lacunarity) + NewDetailFactor * Lacunarity;
-                    GradientMap[y][x] = DetailFactor;
-                }
-
-                NoiseMap[y][x] += PerlinValue;
-            }
-        }
+        GeneratedLandscape->SetIsTemporarilyHiddenInEditor(false);
+    }
+#endif
+}
 
-        Amplitude *= Persistence;
-        FrequencyAcc *= Lacunarity;
+void AAutoWorldGenCore::ImportLandscape(const FLandscapeLayout& Layout, TArray<uint16>&& HeightData)
+{
+#if WITH_EDITOR
+    // Delete existing landscape if it exists  
+    if (GeneratedLandscape && !GeneratedLandscape->IsPendingKillPending())
+    {
+        GetWorld()->DestroyActor(GeneratedLandscape);
+        GeneratedLandscape = nullptr;
     }
 
+    GeneratedLandscape = SpawnLandscape(Layout, MoveTemp(HeightData));
+#endif
+}
+
+ALandscape* AAutoWorldGenCore::SpawnLandscape(const FLandscapeLayout& Layout, TArray<uint16>&& HeightData, const EObjectFlags ObjectFlags)
+{
+#if WITH_EDITOR
+    const int32 QuadsPerSection = Layout.QuadsPerSection;
+    const int32 SectionsPerComponent = Layout.SectionsPerComponent;
+    const int32 HeightmapSize = Layout.GetHeightmapSize();
+    // Resampled quads cover SampleSpacing generated samples, and a finer quantization is scaled back to the same heights
+    const FVector Scale(TileSize * Layout.SampleSpacing, TileSize * Layout.SampleSpacing, TileSize * 128.0 / HeightQuantization.Scale);
 
-    // Normalize the noise value to the specified range
-    for (uint16 y = 0; y < Size; ++y)
-    {
-        for (uint16 x = 0; x < Size; ++x)
-        {
-            const double NoiseHeight = NoiseMap[y][x];
+    const int32 Size = Layout.GetSizeQuads();
+    const int32 HalfSize = Size / 2;
+    const FVector LandscapeLocation = FVector(0, 0, 0);
+
+    // Create the main Landscape Actor
+    FActorSpawnParameters SpawnParameters;
+    SpawnParameters.ObjectFlags = ObjectFlags;
+    ALandscape* Landscape = GetWorld()->SpawnActor<ALandscape>(SpawnParameters);
+    Landscape->SetActorLocation(LandscapeLocation);
+    Landscape->SetActorScale3D(Scale);
 
-            const double NormalizedHeight = FMath::GetMappedRangeValueClamped(
-                FVector2D(-1.0f, 1.0f),
-                Range,
-                NoiseHeight / MaxNoiseHeight
-            );
+    // Generate a new GUID for the landscape
+    FGuid LandscapeGuid = FGuid::NewGuid();
+    Landscape->SetLandscapeGuid(LandscapeGuid);
 
-            NoiseMap[y][x] = NormalizedHeight;
-        }
+    // Prepare HeightMapData with default FGuid() key, the samples are moved in rather than copied
+    TMap<FGuid, TArray<uint16>> HeightMapData;
+    HeightMapData.Add(FGuid(), MoveTemp(HeightData));
+
+    // Import looks up the layers of the default FGuid(). A paint layer without a layer info object
+    // cannot be painted, so none is created instead of a zeroed placeholder of the heightmap size.
+    TMap<FGuid, TArray<FLandscapeImportLayerInfo>> MaterialLayerMap;
+    MaterialLayerMap.Add(FGuid(), TArray<FLandscapeImportLayerInfo>());
+
+    TArray<FLandscapeLayer> NoImportLayers;
+
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::Import);
+        SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_Import);
+        FTerrainStageScope StageScope(&LastGenerationStats, ETerrainStage::Import);
+
+        // Call the Import method
+        Landscape->Import(
+            LandscapeGuid,
+            -HalfSize,
+            -HalfSize,
+            Size - HalfSize,
+            Size - HalfSize,
+            SectionsPerComponent,
+            QuadsPerSection,
+            HeightMapData,
+            TEXT("GeneratedHeightmap"),
+            MaterialLayerMap,
+            ELandscapeImportAlphamapType::Layered,
+            TArrayView<const FLandscapeLayer>(NoImportLayers)
+        );
     }
 
-    return NoiseMap;
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::PostEditChange);
+        SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_PostEditChange);
+        FTerrainStageScope StageScope(&LastGenerationStats, ETerrainStage::PostEditChange);
+        Landscape->PostEditChange();
+    }
+
+    return Landscape;
+#else
+    return nullptr;
+#endif
+}
+
+FString AAutoWorldGenCore::GetHeightfieldCachePath() const
+{
+    return HeightfieldCachePath.IsEmpty()
+        ? FPaths::ProjectSavedDir() / TEXT("AutoWorldGen") / (GetName() + TEXT(".heights"))
+        : HeightfieldCachePath;
+}
+
+FHeightfieldCacheHeader AAutoWorldGenCore::MakeHeightfieldCacheHeader(const int32 HeightmapSize) const
+{
+    return FHeightfieldCacheHeader::Make(Biomes, BiomeWeightEpsilon, HeightQuantization, Resampling, Erosion, WorldSize, TileSize, HeightmapSize);
 }
 
-VMatrix AAutoWorldGenCore::GetDistancesFromCenter(const uint16 Size, FVector2D Origin)
+FHeightfieldCacheHeader AAutoWorldGenCore::MakeHeightfieldCacheHeader(const FGenerationSettings& Settings, const int32 HeightmapSize)
 {
-    VMatrix Distances;
+    return FHeightfieldCacheHeader::Make(Settings.Biomes, Settings.BiomeWeightEpsilon, Settings.HeightQuantization, Settings.Resampling, Settings.Erosion, Settings.WorldSize, Settings.TileSize, HeightmapSize);
+}
 
-    Distances.SetNum(Size);
-    for (uint16 y = 0; y < Size; ++y)
+bool AAutoWorldGenCore::ImportCachedHeightfield()
+{
+#if WITH_EDITOR
+    if (!bUseHeightfieldCache)
+    {
+        return false;
+    }
+
+    const FLandscapeLayout Layout = GetLandscapeLayout(WorldSize, Resampling);
+    if (Layout.NumComponents == 0)
     {
-        Distances[y].SetNum(Size);
-        for (uint16 x = 0; x < Size; ++x)
+        return false;
+    }
+
+    const int32 HeightmapSize = Layout.GetHeightmapSize();
+    const FString FilePath = GetHeightfieldCachePath();
+
+    TArray<uint16> HeightData;
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::Import);
+        SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_Import);
+        FTerrainStageScope StageScope(&LastGenerationStats, ETerrainStage::Import);
+
+        const FMappedHeightfieldCache Cache(FilePath, MakeHeightfieldCacheHeader(HeightmapSize));
+        if (!Cache.IsValid())
         {
-            FVector2D Point(x, y);
-            float Distance = FVector2D::Distance(Point, Origin);
-            Distances[y][x] = Distance;
+            return false;
         }
+
+        // Import takes ownership of an array, so the mapped samples are copied once
+        HeightData = TArray<uint16>(Cache.GetSamples());
+        StageScope.AddAllocatedBytes(HeightData.GetAllocatedSize());
     }
 
-    return Distances;
+    UE_LOG(LogTemp, Display, TEXT("Importing cached heights from %s."), *FilePath);
+    ImportLandscape(Layout, MoveTemp(HeightData));
+    return GeneratedLandscape != nullptr;
+#else
+    return false;
+#endif
 }
@@ -4,81 +4,38 @@
 
 #include "CoreMinimal.h"
 #include "VaribleMatrix.h"
+#include "Biome.h"
+#include "TerrainGenerator.h"
+#include "TerrainErosion.h"
+#include "TerrainGenerationStats.h"
+#include "HeightfieldCache.h"
+#include "HeightQuantization.h"
+#include "LandscapeLayout.h"
+#include "TerrainStreamingComponent.h"
 #include "GameFramework/Actor.h"
 #include "Landscape.h"
 #include "Dom/JsonObject.h"
 #include "Serialization/JsonSerializer.h"
 #include "Misc/FileHelper.h"
+#include "Containers/Ticker.h"
+#include "Tasks/Task.h"
 
 #include "AutoWorldGenCore.generated.h"
 
 using namespace VaribleMatrix;
 
-USTRUCT(BlueprintType)
-struct FBiome
-{
-	GENERATED_BODY()
-
-public:
-	UPROPERTY(EditAnywhere)
-	FString Name = "Biome";
-
-	UPROPERTY(EditAnywhere, Category = "Noise")
-	bool bGradientDetailReduction = false;
-
-	UPROPERTY(EditAnywhere, Category = "Noise")
-	double GradientDetailReductionSpeed = 1;
-
-	UPROPERTY(EditAnywhere, Category = "Noise")
-	FVector2D Range = FVector2D(-16.0, 16.0);
-
-	UPROPERTY(EditAnywhere, Category = "Noise")
-	int32 Seed = 0;
-
-	UPROPERTY(EditAnywhere, Category = "Noise")
-	uint8 Octaves = 2;
+class FAsyncTaskNotification;
 
-	// Persistence is the rate at which the amplitude diminishes for each successive octave
-	UPROPERTY(EditAnywhere, Category = "Noise", meta = (ClampMin = "0"))
-	double Persistence = 0.5;
-
-	// Lacunarity is the rate at which the frequency increases for each successive octave
-	UPROPERTY(EditAnywhere, Category = "Noise", meta = (ClampMin = "0"))
-	double Lacunarity = 2;
-
-	UPROPERTY(EditAnywhere, Category = "Noise", meta = (ClampMin = "0.00000000001"))
-	double NoiseScale = 0.01;
-
-	UPROPERTY(EditAnywhere, Category = "Fade")
-	double a = 2;
-
-	UPROPERTY(EditAnywhere, Category = "Fade")
-	double s = 0;
-
-	UPROPERTY(EditAnywhere, Category = "Fade")
-	double k = 1;
-
-	UPROPERTY(EditAnywhere, Category = "Fade")
-	FVector2D Origin = FVector2D(0, 0);
-
-	bool operator==(const FBiome& Other) const
-	{
-		return Range == Other.Range
-			&& bGradientDetailReduction == Other.bGradientDetailReduction
-			&& FMath::IsNearlyEqual(GradientDetailReductionSpeed, Other.GradientDetailReductionSpeed)
-			&& Origin == Other.Origin
-			&& Seed == Other.Seed
-			&& Octaves == Other.Octaves
-			&& FMath::IsNearlyEqual(Persistence, Other.Persistence)
-			&& FMath::IsNearlyEqual(Lacunarity, Other.Lacunarity)
-			&& FMath::IsNearlyEqual(NoiseScale, Other.NoiseScale)
-			&& FMath::IsNearlyEqual(a, Other.a)
-			&& FMath::IsNearlyEqual(s, Other.s)
-			&& FMath::IsNearlyEqual(k, Other.k);
-	}
+UENUM()
+enum class ETerrainStreamTarget : uint8
+{
+	// Fill the generated landscape one band at a time
+	Landscape,
+	// Write a raw 16 bit heightmap to StreamFilePath
+	RawFile
 };
 
-UCLASS()
+UCLASS(config=Game)
 class AUTOWORLDGEN_API AAutoWorldGenCore : public AActor
 {
 	GENERATED_BODY()
@@ -89,6 +46,12 @@ public:
 
 	virtual void OnConstruction(const FTransform& Transform) override;
 
+	virtual void BeginPlay() override;
+
+	virtual void Destroyed() override;
+
+	virtual void BeginDestroy() override;
+
 	UPROPERTY(EditAnywhere, Category = "AutoWorldGen")
 	bool bSaveBiomes;
 
@@ -98,50 +61,233 @@ public:
 	UPROPERTY(EditAnywhere, Category = "AutoWorldGen")
 	bool bAutoGenerate;
 
-	// This will override the WorldSize, SectionsPerComponent, and QuadsPerSection
+	// Pick the component layout closest to WorldSize within LayoutBudget and snap WorldSize to its resolution,
+	// otherwise components of 63 quads are used and the samples past the last of them are dropped
 	UPROPERTY(EditAnywhere, Category = "AutoWorldGen")
 	bool bOptimalWorldSize;
 
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen", meta = (EditCondition = "bOptimalWorldSize"))
+	FLandscapeLayoutBudget LayoutBudget;
+
 	UPROPERTY(EditAnywhere, Category = "AutoWorldGen", meta = (ClampMin = "64"))
-	uint16 WorldSize;
+	int32 WorldSize;
 
 	UPROPERTY(EditAnywhere, Category = "AutoWorldGen", meta = (ClampMin = "1"))
 	uint8 TileSize;
 
+	// Number of threads used for generation, 0 uses all task graph workers. The output does not depend on it.
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen", meta = (ClampMin = "0"))
+	int32 NumThreads;
+
+	// Biomes are only generated where their blend weight reaches this, 0 generates every biome over the whole world
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen", meta = (ClampMin = "0", ClampMax = "0.01"))
+	double BiomeWeightEpsilon;
+
+	// How generated heights are stored in the landscape's 16 bit samples
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Landscape")
+	FHeightQuantization HeightQuantization;
+
+	// Fit the whole world onto the nearest landscape resolution instead of dropping the samples past the last whole component.
+	// Streamed generation always drops them.
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Landscape")
+	EHeightResampling Resampling;
+
+	// Erosion of the whole generated heightfield. Previews, streamed generation and runtime cells
+	// only cover part of the world at a time and are not eroded.
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Erosion")
+	FTerrainErosionSettings Erosion;
+
+	// Show a low resolution landscape right after every edit and generate the full resolution once the edits stop
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Preview")
+	bool bPreviewWhileEditing;
+
+	// The preview takes every PreviewStride-th sample in both directions, with the same noise and falloffs
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Preview", meta = (EditCondition = "bPreviewWhileEditing", ClampMin = "2", ClampMax = "16"))
+	int32 PreviewStride;
+
+	// Seconds without edits after a preview before the full resolution is generated
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Preview", meta = (EditCondition = "bPreviewWhileEditing", ClampMin = "0"))
+	float PreviewRefineDelay;
+
+	// Generate cells around the player while the game runs, from the same biomes and tile size. No landscape is generated in the editor.
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Runtime")
+	bool bGenerateAtRuntime;
+
+	UPROPERTY(VisibleAnywhere, Category = "AutoWorldGen|Runtime")
+	UTerrainStreamingComponent* RuntimeStreaming;
+
+	// Generate the world in bands of landscape components instead of holding it in memory at once
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Streaming")
+	bool bStreamGeneration;
+
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Streaming", meta = (EditCondition = "bStreamGeneration"))
+	ETerrainStreamTarget StreamTarget;
+
+	// Defaults to Saved/AutoWorldGen/Heightmap.r16
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Streaming", meta = (EditCondition = "bStreamGeneration"))
+	FString StreamFilePath;
+
+	// Upper bound for the generator's working set while streaming
+	UPROPERTY(EditAnywhere, Config, Category = "AutoWorldGen|Streaming", meta = (EditCondition = "bStreamGeneration", ClampMin = "16"))
+	int32 StreamingMemoryBudgetMB;
+
+	// Keep the heights of the last generation on disk and import them again while nothing they depend on changed
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Cache")
+	bool bUseHeightfieldCache;
+
+	// Defaults to Saved/AutoWorldGen/<actor name>.heights
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Cache", meta = (EditCondition = "bUseHeightfieldCache"))
+	FString HeightfieldCachePath;
+
+	// Memory for noise octaves kept across biomes and generations, 0 turns the octave cache off
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Cache", meta = (ClampMin = "0"))
+	int32 OctaveCacheBudgetMB;
+
 	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Biomes")
 	TArray<FBiome> Biomes;
 
+	// Time and memory of every stage of the last generation, also logged when it finishes
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "AutoWorldGen|Stats")
+	FTerrainGenerationStats LastGenerationStats;
+
 	UFUNCTION(BlueprintCallable, Category = "AutoWorldGen|Biomes")
 	bool SaveBiomesToJson(const FString& FilePath);
 
 	UFUNCTION(BlueprintCallable, Category = "AutoWorldGen|Biomes")
 	bool LoadBiomesFromJson(const FString& FilePath);
 
+	UFUNCTION(BlueprintCallable, Category = "AutoWorldGen|Biomes")
+	bool SaveBiomesToBinary(const FString& FilePath);
+
+	UFUNCTION(BlueprintCallable, Category = "AutoWorldGen|Biomes")
+	bool LoadBiomesFromBinary(const FString& FilePath);
+
+	// Stops the generation running in the background and removes the preview, the landscape keeps the heights it has
+	UFUNCTION(CallInEditor, Category = "AutoWorldGen")
+	void CancelGeneration();
+
+	bool IsGenerating() const { return ActiveGeneration.IsValid(); }
+
 private:
-	uint16 CurrentWorldSize;
-	uint8 CurrentTileSize;
-	TArray<FBiome> CurrentBiomes;
+	// Every setting the heights or the landscape layout depend on
+	struct FGenerationSettings
+	{
+		int32 WorldSize = 0;
+		uint8 TileSize = 0;
+		TArray<FBiome> Biomes;
+		double BiomeWeightEpsilon = 0.0;
+		FHeightQuantization HeightQuantization;
+		EHeightResampling Resampling = EHeightResampling::None;
+		FLandscapeLayout Layout;
+		FTerrainErosionSettings Erosion;
+
+		// A landscape can be patched instead of built again while everything but the biomes stays the same
+		bool HasSameLayout(const FGenerationSettings& Other) const;
+
+		// Erosion carries a change to one biome across the whole world, so an eroded landscape is always built again
+		bool CanPatch(const FGenerationSettings& Other) const { return HasSameLayout(Other) && !Erosion.IsEnabled(); }
+
+		bool operator==(const FGenerationSettings& Other) const { return HasSameLayout(Other) && Biomes == Other.Biomes; }
+	};
+
+	// A generation running on the task graph. The task only touches this, the game thread polls it.
+	struct FActiveGeneration
+	{
+		FGenerationSettings Settings;
+		TArray<FBiome> PreviousBiomes;
+		bool bSameLayout = false;
+		// Above 1 for previews, which go into PreviewLandscape with Layout
+		int32 SampleStride = 1;
+		FLandscapeLayout Layout;
+		double StartTime = 0.0;
+		FTerrainGenerationProgress Progress;
+		FTerrainGenerationStats Stats;
+		// Heights for a landscape that can be patched, quantized samples for the cache and a landscape that is built again
+		VMatrix Heights;
+		TArray<uint16> HeightData;
+		TUniquePtr<FAsyncTaskNotification> Notification;
+	};
+
+	// Settings of the heights in GeneratedLandscape
+	FGenerationSettings CurrentSettings;
+
+	// Layers of the last generation, so a tweak to one biome only regenerates that biome.
+	// Shared with the generation task, which may outlive a cancel.
+	TSharedPtr<FTerrainLayerCache> LayerCache;
+	// Previews cover other samples, they would flush LayerCache on every switch
+	TSharedPtr<FTerrainLayerCache> PreviewLayerCache;
+
+	// Octaves of every generation of this actor, previews included
+	TSharedPtr<FOctaveLayerCache> OctaveCache;
+
+	TSharedPtr<FActiveGeneration> ActiveGeneration;
+
+	// The last generation task, the next one waits for it because they share the layer cache
+	UE::Tasks::FTask GenerationTask;
+
+	FTSTicker::FDelegateHandle GenerationTickerHandle;
+
+	// Settings of the preview on display, generated at full resolution once RefineTime has passed
+	TOptional<FGenerationSettings> PendingRefinement;
+	double RefineTime = 0.0;
 
 	UPROPERTY(VisibleAnywhere, Transient)
 	ALandscape* GeneratedLandscape;
 
-	bool bIsChanged();
+	// Stands in for GeneratedLandscape, which is hidden meanwhile, until the full resolution is done
+	UPROPERTY(VisibleAnywhere, Transient)
+	ALandscape* PreviewLandscape;
+
+	FGenerationSettings GetGenerationSettings() const;
+
+	void GenerateTerrain(const FGenerationSettings& Settings, const bool bSameLayout);
+
+	// Generates and quantizes the heights in the background, the landscape is written in FinishGeneration.
+	// A SampleStride above 1 generates a preview.
+	void StartGeneration(const FGenerationSettings& Settings, const bool bSameLayout, const int32 SampleStride = 1);
+
+	// Runs on the game thread while a generation is active
+	bool TickGeneration(float DeltaTime);
+
+	void FinishGeneration();
+
+	// Cancels the generation in flight and the pending refinement, the preview stays
+	void StopGeneration();
+
+	void StartGenerationTicker();
+
+	void StopGenerationTicker();
+
+	// Layout a preview of PreviewSize samples is imported with, its spacing is in world samples
+	FLandscapeLayout GetPreviewLayout(const int32 PreviewSize, const int32 SampleStride) const;
+
+	void ShowPreviewLandscape(const FLandscapeLayout& Layout, TArray<uint16>&& HeightData);
+
+	void RemovePreviewLandscape();
+
+	void LogGenerationStats(const double StartTime);
+
+	void GenerateTerrainStreamed();
+
+	// Largest layout that fits Size samples, or with resampling the one closest to it
+	FLandscapeLayout GetLandscapeLayout(const int32 Size, const EHeightResampling InResampling) const;
+
+	// Writes only the components whose heights can differ from PreviousBiomes into GeneratedLandscape.
+	// Heights were generated from Settings. Returns false when the landscape has to be created again instead.
+	bool UpdateLandscape(const VMatrix& Heights, const FGenerationSettings& Settings, const TArray<FBiome>& PreviousBiomes);
+
+	// Replaces GeneratedLandscape with a new landscape built from HeightData
+	void ImportLandscape(const FLandscapeLayout& Layout, TArray<uint16>&& HeightData);
+
+	ALandscape* SpawnLandscape(const FLandscapeLayout& Layout, TArray<uint16>&& HeightData, const EObjectFlags ObjectFlags = RF_NoFlags);
 
-	VMatrix GenerateTerrainNoiseMap();
+	FString GetHeightfieldCachePath() const;
 
-	void CreateLandscape(const VMatrix& Heights);
+	FHeightfieldCacheHeader MakeHeightfieldCacheHeader(const int32 HeightmapSize) const;
 
-	VMatrix GetNoiseMap(
-		const bool bGradientDetailReduction,
-		const double GradientDetailReductionSpeed,
-		const uint16 Size,
-		const FVector2D Range,
-		int32 Seed,
-		const uint8 Octaves,
-		const double Persistence,
-		const double Lacunarity,
-		const double Scale
-	);
+	// Header of a heightfield generated from Settings, the actor's properties may have changed since
+	static FHeightfieldCacheHeader MakeHeightfieldCacheHeader(const FGenerationSettings& Settings, const int32 HeightmapSize);
 
-	VMatrix GetDistancesFromCenter(const uint16 Size, FVector2D Origin);
+	// Imports the cached heights when they were generated from the current settings
+	bool ImportCachedHeightfield();
 };
@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Hash/xxhash.h"
+
+#include "Biome.generated.h"
+
+USTRUCT(BlueprintType)
+struct FBiome
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere)
+	FString Name = "Biome";
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	bool bGradientDetailReduction = false;
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	double GradientDetailReductionSpeed = 1;
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	FVector2D Range = FVector2D(-16.0, 16.0);
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	int32 Seed = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Noise")
+	uint8 Octaves = 2;
+
+	// Persistence is the rate at which the amplitude diminishes for each successive octave
+	UPROPERTY(EditAnywhere, Category = "Noise", meta = (ClampMin = "0"))
+	double Persistence = 0.5;
+
+	// Lacunarity is the rate at which the frequency increases for each successive octave
+	UPROPERTY(EditAnywhere, Category = "Noise", meta = (ClampMin = "0"))
+	double Lacunarity = 2;
+
+	UPROPERTY(EditAnywhere, Category = "Noise", meta = (ClampMin = "0.00000000001"))
+	double NoiseScale = 0.01;
+
+	UPROPERTY(EditAnywhere, Category = "Fade")
+	double a = 2;
+
+	UPROPERTY(EditAnywhere, Category = "Fade")
+	double s = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Fade")
+	double k = 1;
+
+	UPROPERTY(EditAnywhere, Category = "Fade")
+	FVector2D Origin = FVector2D(0, 0);
+
+	// Exact like the hashes below, a biome that is only nearly equal still generates other heights.
+	// Only +0 and -0 compare equal but hash differently, which costs a cache miss and nothing else.
+	bool operator==(const FBiome& Other) const
+	{
+		return Range == Other.Range
+			&& bGradientDetailReduction == Other.bGradientDetailReduction
+			&& GradientDetailReductionSpeed == Other.GradientDetailReductionSpeed
+			&& Origin == Other.Origin
+			&& Seed == Other.Seed
+			&& Octaves == Other.Octaves
+			&& Persistence == Other.Persistence
+			&& Lacunarity == Other.Lacunarity
+			&& NoiseScale == Other.NoiseScale
+			&& a == Other.a
+			&& s == Other.s
+			&& k == Other.k;
+	}
+
+	// Content hash of everything the noise layer depends on
+	uint64 GetNoiseHash() const
+	{
+		FXxHash64Builder Builder;
+		Builder.Update(&bGradientDetailReduction, sizeof(bGradientDetailReduction));
+		Builder.Update(&GradientDetailReductionSpeed, sizeof(GradientDetailReductionSpeed));
+		Builder.Update(&Range, sizeof(Range));
+		Builder.Update(&Seed, sizeof(Seed));
+		Builder.Update(&Octaves, sizeof(Octaves));
+		Builder.Update(&Persistence, sizeof(Persistence));
+		Builder.Update(&Lacunarity, sizeof(Lacunarity));
+		Builder.Update(&NoiseScale, sizeof(NoiseScale));
+		return Builder.Finalize().Hash;
+	}
+
+	// Content hash of everything the falloff weight depends on
+	uint64 GetFalloffHash() const
+	{
+		FXxHash64Builder Builder;
+		Builder.Update(&a, sizeof(a));
+		Builder.Update(&s, sizeof(s));
+		Builder.Update(&k, sizeof(k));
+		Builder.Update(&Origin, sizeof(Origin));
+		return Builder.Finalize().Hash;
+	}
+};
@@ -0,0 +1,338 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BiomePreset.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+    constexpr uint32 BinaryMagic = 0x42475741; // "AWGB"
+
+    // Bump when the biome layout changes, and keep reading the older versions
+    constexpr uint32 BinaryVersion = 1;
+
+    // Lower bound of a serialized biome, used to reject corrupt counts before allocating
+    constexpr int64 MinBiomeSize = 64;
+
+    void SerializeBiome(FArchive& Ar, FBiome& Biome)
+    {
+        Ar << Biome.Name;
+        Ar << Biome.bGradientDetailReduction;
+        Ar << Biome.GradientDetailReductionSpeed;
+        Ar << Biome.Range.X;
+        Ar << Biome.Range.Y;
+        Ar << Biome.Seed;
+        Ar << Biome.Octaves;
+        Ar << Biome.Persistence;
+        Ar << Biome.Lacunarity;
+        Ar << Biome.NoiseScale;
+        Ar << Biome.a;
+        Ar << Biome.s;
+        Ar << Biome.k;
+        Ar << Biome.Origin.X;
+        Ar << Biome.Origin.Y;
+    }
+}
+
+bool BiomePreset::SaveJson(const FString& FilePath, const TArray<FBiome>& Biomes)
+{
+    TSharedPtr<FJsonObject> RootObject = MakeShareable(new FJsonObject);
+
+    TArray<TSharedPtr<FJsonValue>> BiomeArray;
+    for (const FBiome& Biome : Biomes)
+    {
+        TSharedPtr<FJsonObject> BiomeObject = MakeShareable(new FJsonObject);
+
+        // Serialize Biome properties
+        BiomeObject->SetStringField(TEXT("Name"), Biome.Name);
+        BiomeObject->SetBoolField(TEXT("bGradientDetailReduction"), Biome.bGradientDetailReduction);
+        BiomeObject->SetNumberField(TEXT("GradientDetailReductionSpeed"), Biome.GradientDetailReductionSpeed);
+        BiomeObject->SetNumberField(TEXT("RangeMax"), Biome.Range.X);
+        BiomeObject->SetNumberField(TEXT("RangeMin"), Biome.Range.Y);
+        BiomeObject->SetNumberField(TEXT("Seed"), Biome.Seed);
+        BiomeObject->SetNumberField(TEXT("Octaves"), Biome.Octaves);
+        BiomeObject->SetNumberField(TEXT("Persistence"), Biome.Persistence);
+        BiomeObject->SetNumberField(TEXT("Lacunarity"), Biome.Lacunarity);
+        BiomeObject->SetNumberField(TEXT("NoiseScale"), Biome.NoiseScale);
+        BiomeObject->SetNumberField(TEXT("a"), Biome.a);
+        BiomeObject->SetNumberField(TEXT("s"), Biome.s);
+        BiomeObject->SetNumberField(TEXT("k"), Biome.k);
+        BiomeObject->SetNumberField(TEXT("OriginX"), Biome.Origin.X);
+        BiomeObject->SetNumberField(TEXT("OriginY"), Biome.Origin.Y);
+
+        // Add BiomeObject to BiomeArray
+        BiomeArray.Add(MakeShareable(new FJsonValueObject(BiomeObject)));
+    }
+
+    RootObject->SetArrayField(TEXT("Biomes"), BiomeArray);
+
+    // Serialize RootObject to a JSON formatted string
+    FString OutputString;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&OutputString);
+    if (FJsonSerializer::Serialize(RootObject.ToSharedRef(), Writer))
+    {
+        // Save JSON string to file
+        return FFileHelper::SaveStringToFile(OutputString, *FilePath);
+    }
+
+    return false;
+}
+
+bool BiomePreset::LoadJson(const FString& FilePath, TArray<FBiome>& OutBiomes)
+{
+    FString JsonString;
+    if (!FFileHelper::LoadFileToString(JsonString, *FilePath))
+    {
+        return false;
+    }
+
+    TSharedPtr<FJsonObject> RootObject;
+    TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+
+    if (FJsonSerializer::Deserialize(Reader, RootObject) && RootObject.IsValid())
+    {
+        TArray<TSharedPtr<FJsonValue>> BiomeArray = RootObject->GetArrayField(TEXT("Biomes"));
+        OutBiomes.Empty();
+        for (TSharedPtr<FJsonValue> Value : BiomeArray)
+        {
+            TSharedPtr<FJsonObject> BiomeObject = Value->AsObject();
+            if (BiomeObject.IsValid())
+            {
+                FBiome Biome;
+
+                // Deserialize Biome properties
+                Biome.Name = BiomeObject->GetStringField(TEXT("Name"));
+                Biome.bGradientDetailReduction = BiomeObject->GetBoolField(TEXT("bGradientDetailReduction"));
+                Biome.GradientDetailReductionSpeed = BiomeObject->GetNumberField(TEXT("GradientDetailReductionSpeed"));
+                Biome.Range.X = BiomeObject->GetNumberField(TEXT("RangeMax"));
+                Biome.Range.Y = BiomeObject->GetNumberField(TEXT("RangeMin"));
+                Biome.Seed = (int32)BiomeObject->GetNumberField(TEXT("Seed"));
+                Biome.Octaves = (uint8)BiomeObject->GetNumberField(TEXT("Octaves"));
+                Biome.Persistence = BiomeObject->GetNumberField(TEXT("Persistence"));
+                Biome.Lacunarity = BiomeObject->GetNumberField(TEXT("Lacunarity"));
+                Biome.NoiseScale = BiomeObject->GetNumberField(TEXT("NoiseScale"));
+                Biome.a = BiomeObject->GetNumberField(TEXT("a"));
+                Biome.s = BiomeObject->GetNumberField(TEXT("s"));
+                Biome.k = BiomeObject->GetNumberField(TEXT("k"));
+                Biome.Origin.X = BiomeObject->GetNumberField(TEXT("OriginX"));
+                Biome.Origin.Y = BiomeObject->GetNumberField(TEXT("OriginY"));
+
+                OutBiomes.Add(Biome);
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool BiomePreset::Serialize(FArchive& Ar, TArray<FBiome>& Biomes)
+{
+    uint32 Magic = BinaryMagic;
+    uint32 Version = BinaryVersion;
+    Ar << Magic;
+    Ar << Version;
+    if (Ar.IsError() || Magic != BinaryMagic || Version == 0 || Version > BinaryVersion)
+    {
+        return false;
+    }
+
+    int32 Num = Biomes.Num();
+    Ar << Num;
+    if (Ar.IsLoading())
+    {
+        if (Ar.IsError() || Num < 0 || Num > (Ar.TotalSize() - Ar.Tell()) / MinBiomeSize)
+        {
+            return false;
+        }
+        Biomes.SetNum(Num);
+    }
+
+    for (FBiome& Biome : Biomes)
+    {
+        SerializeBiome(Ar, Biome);
+    }
+
+    return !Ar.IsError();
+}
+
+bool BiomePreset::SaveBinary(const FString& FilePath, const TArray<FBiome>& Biomes)
+{
+    TArray<uint8> Data;
+    FMemoryWriter Writer(Data);
+
+    // Saving only reads the biomes
+    if (!Serialize(Writer, const_cast<TArray<FBiome>&>(Biomes)))
+    {
+        return false;
+    }
+
+    return FFileHelper::SaveArrayToFile(Data, *FilePath);
+}
+
+bool BiomePreset::LoadBinary(const FString& FilePath, TArray<FBiome>& OutBiomes)
+{
+    // One read of the whole file, the biomes are then taken straight out of memory
+    TArray<uint8> Data;
+    if (!FFileHelper::LoadFileToArray(Data, *FilePath))
+    {
+        return false;
+    }
+
+    FMemoryReader Reader(Data);
+    TArray<FBiome> Biomes;
+    if (!Serialize(Reader, Biomes))
+    {
+        UE_LOG(LogTemp, Error, TEXT("%s is not a biome preset this version can read."), *FilePath);
+        return false;
+    }
+
+    OutBiomes = MoveTemp(Biomes);
+    return true;
+}
+
+bool BiomePreset::Save(const FString& FilePath, const TArray<FBiome>& Biomes)
+{
+    return FPaths::GetExtension(FilePath) == BinaryExtension ? SaveBinary(FilePath, Biomes) : SaveJson(FilePath, Biomes);
+}
+
+bool BiomePreset::Load(const FString& FilePath, TArray<FBiome>& OutBiomes)
+{
+    return FPaths::GetExtension(FilePath) == BinaryExtension ? LoadBinary(FilePath, OutBiomes) : LoadJson(FilePath, OutBiomes);
+}
+
+bool BiomePreset::AreIdentical(const TArray<FBiome>& A, const TArray<FBiome>& B)
+{
+    if (A.Num() != B.Num())
+    {
+        return false;
+    }
+
+    // The hashes cover the exact bits of every generation parameter
+    for (int32 i = 0; i < A.Num(); i++)
+    {
+        if (A[i].Name != B[i].Name || A[i].GetNoiseHash() != B[i].GetNoiseHash() || A[i].GetFalloffHash() != B[i].GetFalloffHash())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+namespace
+{
+    FAutoConsoleCommand ConvertBiomesCommand(
+        TEXT("AutoWorldGen.ConvertBiomes"),
+        TEXT("Converts a biome preset between JSON and binary, the format follows the extension (.biomes is binary). Arguments: input path, output path."),
+        FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+        {
+            if (Args.Num() < 2)
+            {
+                UE_LOG(LogTemp, Warning, TEXT("Usage: AutoWorldGen.ConvertBiomes <Input> <Output>"));
+                return;
+            }
+
+            TArray<FBiome> Biomes;
+            if (!BiomePreset::Load(Args[0], Biomes))
+            {
+                UE_LOG(LogTemp, Error, TEXT("Failed to load biomes from %s."), *Args[0]);
+                return;
+            }
+
+            // Read the output back so a lossy conversion does not go unnoticed
+            TArray<FBiome> Converted;
+            if (!BiomePreset::Save(Args[1], Biomes) || !BiomePreset::Load(Args[1], Converted))
+            {
+                UE_LOG(LogTemp, Error, TEXT("Failed to write biomes to %s."), *Args[1]);
+                return;
+            }
+            if (!BiomePreset::AreIdentical(Biomes, Converted))
+            {
+                UE_LOG(LogTemp, Warning, TEXT("The biomes in %s differ from %s."), *Args[1], *Args[0]);
+                return;
+            }
+
+            UE_LOG(LogTemp, Display, TEXT("Converted %d biomes from %s to %s."), Biomes.Num(), *Args[0], *Args[1]);
+        })
+    );
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBiomePresetRoundTripTest, "AutoWorldGen.BiomePreset.RoundTrip", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FBiomePresetRoundTripTest::RunTest(const FString& Parameters)
+{
+    // Every field away from its default, values that need all 17 digits, and names the JSON writer has to escape
+    const TArray<FString> Names = {
+        TEXT(""),
+        TEXT("Plain"),
+        TEXT("Quote \" and backslash \\"),
+        TEXT("Line\nbreak\tand tab"),
+        TEXT("Gr\u00FCn \u5C71 \U0001F3D4"),
+        FString::ChrN(1000, TEXT('x')),
+    };
+
+    TArray<FBiome> Biomes;
+    for (int32 i = 0; i < Names.Num(); i++)
+    {
+        FBiome& Biome = Biomes.AddDefaulted_GetRef();
+        Biome.Name = Names[i];
+        Biome.bGradientDetailReduction = i % 2 == 0;
+        Biome.GradientDetailReductionSpeed = 1.0 / 3.0 + i;
+        Biome.Range = FVector2D(-123.456789012345 * i, 1.0e-300 + i);
+        Biome.Seed = i % 2 == 0 ? MAX_int32 - i : -7 * i - 1;
+        Biome.Octaves = static_cast<uint8>(255 - i);
+        Biome.Persistence = 0.1 * (i + 1);
+        Biome.Lacunarity = 2.0 + 1.0e-15 * i;
+        Biome.NoiseScale = 1.0e-11 * (i + 1);
+        Biome.a = 1.0e300 / (i + 1);
+        Biome.s = -0.7 * i - 0.3;
+        Biome.k = FMath::Sqrt(2.0) * (i + 1);
+        Biome.Origin = FVector2D(8191.5 * i, -4096.25 - i);
+    }
+
+    const FString TempDir = FPaths::AutomationTransientDir() / TEXT("AutoWorldGen");
+    const FString JsonPath = TempDir / TEXT("RoundTrip.json");
+    const FString BinaryPath = TempDir / (FString(TEXT("RoundTrip.")) + BiomePreset::BinaryExtension);
+
+    TArray<FBiome> FromJson;
+    TestTrue(TEXT("JSON preset saved"), BiomePreset::SaveJson(JsonPath, Biomes));
+    TestTrue(TEXT("JSON preset loaded"), BiomePreset::LoadJson(JsonPath, FromJson));
+    TestTrue(TEXT("JSON round trip gives back identical biomes"), BiomePreset::AreIdentical(Biomes, FromJson));
+
+    TArray<FBiome> FromBinary;
+    TestTrue(TEXT("Binary preset saved"), BiomePreset::SaveBinary(BinaryPath, Biomes));
+    TestTrue(TEXT("Binary preset loaded"), BiomePreset::LoadBinary(BinaryPath, FromBinary));
+    TestTrue(TEXT("Binary round trip gives back identical biomes"), BiomePreset::AreIdentical(Biomes, FromBinary));
+
+    // Save and Load pick the format from the extension
+    TArray<FBiome> FromAny;
+    TestTrue(TEXT("Load reads the binary preset by its extension"), BiomePreset::Load(BinaryPath, FromAny) && BiomePreset::AreIdentical(Biomes, FromAny));
+
+    // A truncated preset is rejected instead of loading partial biomes
+    TArray<uint8> Data;
+    FMemoryWriter Writer(Data);
+    BiomePreset::Serialize(Writer, Biomes);
+    Data.SetNum(Data.Num() / 2);
+    FMemoryReader Reader(Data);
+    TArray<FBiome> Truncated;
+    TestFalse(TEXT("Truncated binary preset is rejected"), BiomePreset::Serialize(Reader, Truncated));
+
+    IFileManager::Get().Delete(*JsonPath);
+    IFileManager::Get().Delete(*BinaryPath);
+    return true;
+}
+
+#endif
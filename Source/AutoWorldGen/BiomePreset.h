@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Biome.h"
+
+/**
+ * Reading and writing biome sets as presets.
+ * JSON presets are meant to be edited by hand. Binary presets hold the same fields in a versioned
+ * FArchive layout, a magic, version and biome count followed by every biome, and load in one read
+ * without parsing, for tools that go through large preset libraries.
+ */
+namespace BiomePreset
+{
+	// Files with this extension are binary presets, everything else is read as JSON
+	constexpr const TCHAR* BinaryExtension = TEXT("biomes");
+
+	AUTOWORLDGEN_API bool SaveJson(const FString& FilePath, const TArray<FBiome>& Biomes);
+	AUTOWORLDGEN_API bool LoadJson(const FString& FilePath, TArray<FBiome>& OutBiomes);
+
+	AUTOWORLDGEN_API bool SaveBinary(const FString& FilePath, const TArray<FBiome>& Biomes);
+	AUTOWORLDGEN_API bool LoadBinary(const FString& FilePath, TArray<FBiome>& OutBiomes);
+
+	// Binary layout in both directions. Loading fails on data that is not a preset of a known version.
+	AUTOWORLDGEN_API bool Serialize(FArchive& Ar, TArray<FBiome>& Biomes);
+
+	// Pick the format from the extension of FilePath
+	AUTOWORLDGEN_API bool Save(const FString& FilePath, const TArray<FBiome>& Biomes);
+	AUTOWORLDGEN_API bool Load(const FString& FilePath, TArray<FBiome>& OutBiomes);
+
+	// True when both sets hold bit-identical biomes, names included
+	AUTOWORLDGEN_API bool AreIdentical(const TArray<FBiome>& A, const TArray<FBiome>& B);
+}
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "HeightQuantization.generated.h"
+
+UENUM()
+enum class EHeightResampling : uint8
+{
+	// Keep the samples that fill whole landscape components and drop the rows and columns past them
+	None,
+	// Stretch the whole heightfield onto the nearest landscape resolution
+	Bilinear,
+	// Like Bilinear with a Catmull-Rom filter, keeps more of the detail
+	Bicubic
+};
+
+/**
+ * How generated heights map to uint16 landscape samples: (Height - Offset) * Scale + 32768, clamped.
+ */
+USTRUCT(BlueprintType)
+struct AUTOWORLDGEN_API FHeightQuantization
+{
+	GENERATED_BODY()
+
+public:
+	// Generated height that lands on the landscape's zero
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen")
+	double Offset = 256.0;
+
+	// Samples per unit of generated height. Larger values give finer steps over a smaller height range,
+	// the landscape is scaled to keep the same world height.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen", meta = (ClampMin = "0.001"))
+	double Scale = 128.0;
+
+	bool operator==(const FHeightQuantization& Other) const
+	{
+		return Offset == Other.Offset && Scale == Other.Scale;
+	}
+
+	bool operator!=(const FHeightQuantization& Other) const
+	{
+		return !(*this == Other);
+	}
+};
@@ -0,0 +1,243 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Row-major heightfield backed by a single allocation.
+ * Every row starts on a 64 byte boundary, so Stride can be larger than Width.
+ */
+template<typename InScalarType>
+class THeightfield
+{
+public:
+	typedef InScalarType ScalarType;
+
+	static constexpr int32 Alignment = 64;
+
+	THeightfield() = default;
+
+	THeightfield(const int32 InWidth, const int32 InHeight)
+	{
+		Init(InWidth, InHeight);
+	}
+
+	THeightfield(const int32 InWidth, const int32 InHeight, const ScalarType Value)
+	{
+		Init(InWidth, InHeight);
+		Fill(Value);
+	}
+
+	THeightfield(const THeightfield& Other)
+	{
+		*this = Other;
+	}
+
+	THeightfield(THeightfield&& Other)
+	{
+		*this = MoveTemp(Other);
+	}
+
+	THeightfield& operator=(const THeightfield& Other)
+	{
+		if (this != &Other)
+		{
+			Init(Other.Width, Other.Height);
+			if (Data)
+			{
+				FMemory::Memcpy(Data, Other.Data, static_cast<SIZE_T>(Height) * Stride * sizeof(ScalarType));
+			}
+		}
+		return *this;
+	}
+
+	THeightfield& operator=(THeightfield&& Other)
+	{
+		if (this != &Other)
+		{
+			Reset();
+			Data = Other.Data;
+			Width = Other.Width;
+			Height = Other.Height;
+			Stride = Other.Stride;
+
+			Other.Data = nullptr;
+			Other.Width = 0;
+			Other.Height = 0;
+			Other.Stride = 0;
+		}
+		return *this;
+	}
+
+	~THeightfield()
+	{
+		Reset();
+	}
+
+	// Reallocates the storage, the contents are left uninitialized
+	void Init(const int32 InWidth, const int32 InHeight)
+	{
+		check(InWidth >= 0 && InHeight >= 0);
+
+		// Pad every row up to the next cache line
+		constexpr int32 ElementsPerLine = Alignment / sizeof(ScalarType);
+		const int32 NewStride = Align(InWidth, ElementsPerLine);
+
+		if (Data && static_cast<int64>(NewStride) * InHeight == static_cast<int64>(Stride) * Height)
+		{
+			Width = InWidth;
+			Height = InHeight;
+			Stride = NewStride;
+			return;
+		}
+
+		Reset();
+
+		Width = InWidth;
+		Height = InHeight;
+		Stride = NewStride;
+
+		const SIZE_T Bytes = static_cast<SIZE_T>(Height) * Stride * sizeof(ScalarType);
+		if (Bytes > 0)
+		{
+			Data = static_cast<ScalarType*>(FMemory::Malloc(Bytes, Alignment));
+		}
+	}
+
+	void Fill(const ScalarType Value)
+	{
+		for (int32 y = 0; y < Height; ++y)
+		{
+			ScalarType* RowData = GetRowData(y);
+			for (int32 x = 0; x < Width; ++x)
+			{
+				RowData[x] = Value;
+			}
+		}
+	}
+
+	void Reset()
+	{
+		if (Data)
+		{
+			FMemory::Free(Data);
+			Data = nullptr;
+		}
+		Width = 0;
+		Height = 0;
+		Stride = 0;
+	}
+
+	FORCEINLINE int32 GetWidth() const { return Width; }
+	FORCEINLINE int32 GetHeight() const { return Height; }
+	FORCEINLINE int32 GetStride() const { return Stride; }
+	FORCEINLINE bool IsEmpty() const { return Width == 0 || Height == 0; }
+
+	FORCEINLINE int64 GetAllocatedSize() const { return static_cast<int64>(Height) * Stride * sizeof(ScalarType); }
+
+	FORCEINLINE bool HasSameDimensions(const THeightfield& Other) const
+	{
+		return Width == Other.Width && Height == Other.Height;
+	}
+
+	FORCEINLINE ScalarType* GetRowData(const int32 Y)
+	{
+		checkSlow(Y >= 0 && Y < Height);
+		return Data + static_cast<int64>(Y) * Stride;
+	}
+
+	FORCEINLINE const ScalarType* GetRowData(const int32 Y) const
+	{
+		checkSlow(Y >= 0 && Y < Height);
+		return Data + static_cast<int64>(Y) * Stride;
+	}
+
+	FORCEINLINE TArrayView<ScalarType> Row(const int32 Y)
+	{
+		return TArrayView<ScalarType>(GetRowData(Y), Width);
+	}
+
+	FORCEINLINE TArrayView<const ScalarType> Row(const int32 Y) const
+	{
+		return TArrayView<const ScalarType>(GetRowData(Y), Width);
+	}
+
+	FORCEINLINE ScalarType& At(const int32 X, const int32 Y)
+	{
+		checkSlow(X >= 0 && X < Width);
+		return GetRowData(Y)[X];
+	}
+
+	FORCEINLINE ScalarType At(const int32 X, const int32 Y) const
+	{
+		checkSlow(X >= 0 && X < Width);
+		return GetRowData(Y)[X];
+	}
+
+	// Copy of the samples inside Region, which must lie within the heightfield
+	THeightfield Crop(const FIntRect& Region) const
+	{
+		check(Region.Min.X >= 0 && Region.Min.Y >= 0 && Region.Max.X <= Width && Region.Max.Y <= Height);
+
+		THeightfield Result(Region.Width(), Region.Height());
+		for (int32 y = 0; y < Result.Height; ++y)
+		{
+			FMemory::Memcpy(Result.GetRowData(y), GetRowData(Region.Min.Y + y) + Region.Min.X, Result.Width * sizeof(ScalarType));
+		}
+
+		return Result;
+	}
+
+	// Conversion shim for code that still passes jagged TArray<TArray<double>> around
+	static THeightfield FromJagged(const TArray<TArray<double>>& Jagged)
+	{
+		THeightfield Result;
+
+		const int32 Rows = Jagged.Num();
+		const int32 Cols = Rows > 0 ? Jagged[0].Num() : 0;
+		Result.Init(Cols, Rows);
+
+		for (int32 y = 0; y < Rows; ++y)
+		{
+			if (Jagged[y].Num() != Cols)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Jagged matrix rows must all have the same length."));
+				Result.Reset();
+				return Result;
+			}
+
+			ScalarType* RowData = Result.GetRowData(y);
+			for (int32 x = 0; x < Cols; ++x)
+			{
+				RowData[x] = static_cast<ScalarType>(Jagged[y][x]);
+			}
+		}
+
+		return Result;
+	}
+
+	TArray<TArray<double>> ToJagged() const
+	{
+		TArray<TArray<double>> Jagged;
+		Jagged.SetNum(Height);
+
+		for (int32 y = 0; y < Height; ++y)
+		{
+			const ScalarType* RowData = GetRowData(y);
+			Jagged[y].SetNumUninitialized(Width);
+			for (int32 x = 0; x < Width; ++x)
+			{
+				Jagged[y][x] = RowData[x];
+			}
+		}
+
+		return Jagged;
+	}
+
+private:
+	ScalarType* Data = nullptr;
+	int32 Width = 0;
+	int32 Height = 0;
+	int32 Stride = 0;
+};
@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HeightfieldCache.h"
+#include "VaribleMatrix.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+
+FHeightfieldCacheHeader FHeightfieldCacheHeader::Make(const TArray<FBiome>& Biomes, const double WeightEpsilon, const FHeightQuantization& Quantization,
+    const EHeightResampling Resampling, const FTerrainErosionSettings& Erosion, const int32 WorldSize, const int32 TileSize, const int32 HeightmapSize)
+{
+    // Heights generated in float and double differ in the last quantization step
+    const int32 Precision = AUTOWORLDGEN_DOUBLE_PRECISION;
+
+    FXxHash64Builder Builder;
+    Builder.Update(&Precision, sizeof(Precision));
+    Builder.Update(&WeightEpsilon, sizeof(WeightEpsilon));
+    Builder.Update(&Quantization.Offset, sizeof(Quantization.Offset));
+    Builder.Update(&Quantization.Scale, sizeof(Quantization.Scale));
+    Builder.Update(&Resampling, sizeof(Resampling));
+    Erosion.AppendHash(Builder);
+    for (const FBiome& Biome : Biomes)
+    {
+        const uint64 NoiseHash = Biome.GetNoiseHash();
+        const uint64 FalloffHash = Biome.GetFalloffHash();
+        Builder.Update(&NoiseHash, sizeof(NoiseHash));
+        Builder.Update(&FalloffHash, sizeof(FalloffHash));
+    }
+
+    FHeightfieldCacheHeader Header;
+    Header.GenerationHash = Builder.Finalize().Hash;
+    Header.WorldSize = WorldSize;
+    Header.TileSize = TileSize;
+    Header.Width = HeightmapSize;
+    Header.Height = HeightmapSize;
+    return Header;
+}
+
+FHeightfieldCacheSink::FHeightfieldCacheSink(const FString& InFilePath, const FHeightfieldCacheHeader& InHeader)
+    : FRawHeightmapSink(InFilePath + TEXT(".tmp"), FIntPoint(InHeader.Width, InHeader.Height), sizeof(FHeightfieldCacheHeader))
+    , FilePath(InFilePath)
+    , TempFilePath(InFilePath + TEXT(".tmp"))
+    , Header(InHeader)
+{
+}
+
+FHeightfieldCacheSink::~FHeightfieldCacheSink()
+{
+    // Finish was never called or failed, drop the partial file
+    if (File.IsValid())
+    {
+        File.Reset();
+        FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*TempFilePath);
+    }
+}
+
+bool FHeightfieldCacheSink::Finish()
+{
+    if (!File.IsValid())
+    {
+        return false;
+    }
+
+    // The header goes in last, a file without it is rejected on load
+    if (!File->Seek(0) || !File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header)) || !File->Flush())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Failed to write %s."), *TempFilePath);
+        return false;
+    }
+    File.Reset();
+
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    PlatformFile.DeleteFile(*FilePath);
+    if (!PlatformFile.MoveFile(*FilePath, *TempFilePath))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Failed to move %s to %s."), *TempFilePath, *FilePath);
+        PlatformFile.DeleteFile(*TempFilePath);
+        return false;
+    }
+
+    return true;
+}
+
+FMappedHeightfieldCache::FMappedHeightfieldCache(const FString& FilePath, const FHeightfieldCacheHeader& Expected)
+    : Header(Expected)
+{
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    if (!PlatformFile.FileExists(*FilePath))
+    {
+        return;
+    }
+
+    MappedFile.Reset(PlatformFile.OpenMapped(*FilePath));
+    if (!MappedFile.IsValid())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Failed to map %s."), *FilePath);
+        return;
+    }
+
+    const int64 DataSize = static_cast<int64>(Expected.Width) * Expected.Height * sizeof(uint16);
+    if (MappedFile->GetFileSize() != sizeof(FHeightfieldCacheHeader) + DataSize)
+    {
+        UE_LOG(LogTemp, Log, TEXT("%s was written for a different world size."), *FilePath);
+        return;
+    }
+
+    MappedRegion.Reset(MappedFile->MapRegion(0, sizeof(FHeightfieldCacheHeader) + DataSize));
+    if (!MappedRegion.IsValid())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Failed to map %s."), *FilePath);
+        return;
+    }
+
+    FHeightfieldCacheHeader FileHeader;
+    FMemory::Memcpy(&FileHeader, MappedRegion->GetMappedPtr(), sizeof(FileHeader));
+    if (!(FileHeader == Expected))
+    {
+        UE_LOG(LogTemp, Log, TEXT("%s is out of date."), *FilePath);
+        MappedRegion.Reset();
+        return;
+    }
+
+    Samples = reinterpret_cast<const uint16*>(MappedRegion->GetMappedPtr() + sizeof(FHeightfieldCacheHeader));
+}
+
+FMappedHeightfieldCache::~FMappedHeightfieldCache()
+{
+    MappedRegion.Reset();
+    MappedFile.Reset();
+}
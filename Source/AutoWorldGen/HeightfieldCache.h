@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Biome.h"
+#include "TerrainTileSink.h"
+#include "HeightQuantization.h"
+#include "TerrainErosion.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Header of a heightfield cache file. The file holds the quantized heightmap of one generation:
+ * this header followed by Width * Height little-endian uint16 samples, row by row.
+ */
+struct FHeightfieldCacheHeader
+{
+	static constexpr uint32 MagicValue = 0x48475741; // "AWGH"
+	// Bump whenever the generator gives different heights for the same settings, older files are then generated again
+	static constexpr uint32 CurrentVersion = 2;
+
+	uint32 Magic = MagicValue;
+	uint32 Version = CurrentVersion;
+	// Hash of the biomes and every setting that changes the generated heights
+	uint64 GenerationHash = 0;
+	int32 WorldSize = 0;
+	int32 TileSize = 0;
+	int32 Width = 0;
+	int32 Height = 0;
+
+	static AUTOWORLDGEN_API FHeightfieldCacheHeader Make(const TArray<FBiome>& Biomes, const double WeightEpsilon, const FHeightQuantization& Quantization,
+		const EHeightResampling Resampling, const FTerrainErosionSettings& Erosion, const int32 WorldSize, const int32 TileSize, const int32 HeightmapSize);
+
+	bool operator==(const FHeightfieldCacheHeader& Other) const
+	{
+		return Magic == Other.Magic
+			&& Version == Other.Version
+			&& GenerationHash == Other.GenerationHash
+			&& WorldSize == Other.WorldSize
+			&& TileSize == Other.TileSize
+			&& Width == Other.Width
+			&& Height == Other.Height;
+	}
+};
+
+static_assert(sizeof(FHeightfieldCacheHeader) == 32, "The header is written to disk as is.");
+
+/**
+ * Writes a heightfield cache file. Samples go to a temporary file next to FilePath,
+ * and Finish replaces the previous cache with it, so a cut off write never looks valid.
+ */
+class AUTOWORLDGEN_API FHeightfieldCacheSink : public FRawHeightmapSink
+{
+public:
+	FHeightfieldCacheSink(const FString& InFilePath, const FHeightfieldCacheHeader& InHeader);
+	virtual ~FHeightfieldCacheSink();
+
+	bool Finish();
+
+private:
+	FString FilePath;
+	FString TempFilePath;
+	FHeightfieldCacheHeader Header;
+};
+
+/**
+ * Read-only view of a heightfield cache file, memory-mapped instead of read.
+ */
+class AUTOWORLDGEN_API FMappedHeightfieldCache
+{
+public:
+	// Maps FilePath when its header equals Expected, IsValid() is false otherwise
+	FMappedHeightfieldCache(const FString& FilePath, const FHeightfieldCacheHeader& Expected);
+	~FMappedHeightfieldCache();
+
+	bool IsValid() const { return Samples != nullptr; }
+
+	FIntPoint GetSize() const { return FIntPoint(Header.Width, Header.Height); }
+
+	TArrayView<const uint16> GetSamples() const { return TArrayView<const uint16>(Samples, Samples ? Header.Width * Header.Height : 0); }
+
+private:
+	// The region has to be released before the file handle
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	FHeightfieldCacheHeader Header;
+	const uint16* Samples = nullptr;
+};
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LandscapeLayout.h"
+
+#include "HAL/IConsoleManager.h"
+
+namespace
+{
+    // Section sizes and sections per component the landscape editor offers
+    constexpr int32 ValidQuadsPerSection[] = { 7, 15, 31, 63, 127, 255 };
+    constexpr int32 ValidSectionsPerComponent[] = { 1, 2 };
+
+    // Lexicographic, the size error comes first
+    bool IsBetterLayout(const FLandscapeLayout& Layout, const FLandscapeLayout& Best, const int32 TargetQuads)
+    {
+        const int32 Error = FMath::Abs(Layout.GetSizeQuads() - TargetQuads);
+        const int32 BestError = FMath::Abs(Best.GetSizeQuads() - TargetQuads);
+        if (Error != BestError)
+        {
+            return Error < BestError;
+        }
+        if (Layout.NumComponents != Best.NumComponents)
+        {
+            return Layout.NumComponents < Best.NumComponents;
+        }
+        return Layout.GetNumSections() < Best.GetNumSections();
+    }
+}
+
+FLandscapeLayout FLandscapeLayout::Solve(const int32 TargetQuads, const FLandscapeLayoutBudget& Budget)
+{
+    FLandscapeLayout Best;
+    Best.QuadsPerSection = ValidQuadsPerSection[0];
+    Best.SectionsPerComponent = 1;
+    Best.NumComponents = 1;
+
+    for (const int32 SectionsPerComponent : ValidSectionsPerComponent)
+    {
+        // Components per side the budget allows with this many sections each
+        const int32 MaxComponents = FMath::Min(FMath::Max(Budget.MaxComponents, 1), FMath::Max(Budget.MaxSections, 1) / (SectionsPerComponent * SectionsPerComponent));
+        const int32 MaxComponentsPerSide = FMath::FloorToInt32(FMath::Sqrt(static_cast<double>(MaxComponents)));
+        if (MaxComponentsPerSide < 1)
+        {
+            continue;
+        }
+
+        for (const int32 QuadsPerSection : ValidQuadsPerSection)
+        {
+            FLandscapeLayout Layout;
+            Layout.QuadsPerSection = QuadsPerSection;
+            Layout.SectionsPerComponent = SectionsPerComponent;
+
+            // Only the counts on either side of the target can be closest to it
+            const int32 ComponentSize = Layout.GetComponentSizeQuads();
+            const int32 Lower = FMath::Clamp(FMath::Max(TargetQuads, 1) / ComponentSize, 1, MaxComponentsPerSide);
+            const int32 Upper = FMath::Clamp(FMath::DivideAndRoundUp(FMath::Max(TargetQuads, 1), ComponentSize), 1, MaxComponentsPerSide);
+            for (const int32 NumComponents : { Lower, Upper })
+            {
+                Layout.NumComponents = NumComponents;
+                if (IsBetterLayout(Layout, Best, TargetQuads))
+                {
+                    Best = Layout;
+                }
+            }
+        }
+    }
+
+    return Best;
+}
+
+namespace
+{
+    FAutoConsoleCommand SolveLandscapeLayoutCommand(
+        TEXT("AutoWorldGen.SolveLandscapeLayout"),
+        TEXT("Logs the landscape layout chosen for a world size. Arguments: world size in samples, optional component and section budget."),
+        FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+        {
+            if (Args.Num() < 1)
+            {
+                UE_LOG(LogTemp, Warning, TEXT("Usage: AutoWorldGen.SolveLandscapeLayout <WorldSize> [MaxComponents] [MaxSections]"));
+                return;
+            }
+
+            const int32 WorldSize = FCString::Atoi(*Args[0]);
+            FLandscapeLayoutBudget Budget;
+            if (Args.Num() > 1)
+            {
+                Budget.MaxComponents = FCString::Atoi(*Args[1]);
+            }
+            if (Args.Num() > 2)
+            {
+                Budget.MaxSections = FCString::Atoi(*Args[2]);
+            }
+
+            const FLandscapeLayout Layout = FLandscapeLayout::Solve(WorldSize - 1, Budget);
+            UE_LOG(LogTemp, Display, TEXT("%d samples: %dx%d components of %dx%d sections with %d quads, %d samples, %d sections."),
+                WorldSize, Layout.NumComponents, Layout.NumComponents, Layout.SectionsPerComponent, Layout.SectionsPerComponent,
+                Layout.QuadsPerSection, Layout.GetHeightmapSize(), Layout.GetNumSections());
+        })
+    );
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "LandscapeLayout.generated.h"
+
+/**
+ * Rendering limits for a solved landscape layout. Every component adds streaming and update
+ * overhead, every section is drawn and picks its LOD on its own.
+ */
+USTRUCT(BlueprintType)
+struct AUTOWORLDGEN_API FLandscapeLayoutBudget
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen", meta = (ClampMin = "1"))
+	int32 MaxComponents = 1024;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen", meta = (ClampMin = "1"))
+	int32 MaxSections = 4096;
+
+	bool operator==(const FLandscapeLayoutBudget& Other) const
+	{
+		return MaxComponents == Other.MaxComponents && MaxSections == Other.MaxSections;
+	}
+};
+
+// Landscape component layout for a square heightmap
+struct AUTOWORLDGEN_API FLandscapeLayout
+{
+	int32 QuadsPerSection = 63;
+	int32 SectionsPerComponent = 1;
+	int32 NumComponents = 0;
+	// Generated samples per landscape quad, not 1 when the heights are resampled
+	double SampleSpacing = 1.0;
+
+	int32 GetComponentSizeQuads() const { return QuadsPerSection * SectionsPerComponent; }
+	int32 GetSizeQuads() const { return NumComponents * GetComponentSizeQuads(); }
+	int32 GetHeightmapSize() const { return GetSizeQuads() + 1; }
+	int32 GetNumSections() const { return NumComponents * NumComponents * SectionsPerComponent * SectionsPerComponent; }
+
+	bool operator==(const FLandscapeLayout& Other) const
+	{
+		return QuadsPerSection == Other.QuadsPerSection
+			&& SectionsPerComponent == Other.SectionsPerComponent
+			&& NumComponents == Other.NumComponents
+			&& SampleSpacing == Other.SampleSpacing;
+	}
+
+	/**
+	 * Picks the valid section size, sections per component and component count within Budget whose
+	 * size comes closest to TargetQuads. Ties go to fewer components, then to fewer sections.
+	 */
+	static FLandscapeLayout Solve(const int32 TargetQuads, const FLandscapeLayoutBudget& Budget);
+};
@@ -0,0 +1,469 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PerlinNoise.h"
+
+#include "Misc/AutomationTest.h"
+
+namespace PerlinNoise
+{
+    namespace
+    {
+        // The random permutation FMath::PerlinNoise2D uses (UnrealMath.cpp), indexed & 255 instead of repeated twice
+        const uint8 Permutation[256] = {
+        63, 9, 212, 205, 31, 128, 72, 59, 137, 203, 195, 170, 181, 115, 165, 40,
+        116, 139, 175, 225, 132, 99, 222, 2, 41, 15, 197, 93, 169, 90, 228, 43,
+        221, 38, 206, 204, 73, 17, 97, 10, 96, 47, 32, 138, 136, 30, 219, 78,
+        224, 13, 193, 88, 134, 211, 7, 112, 176, 19, 106, 83, 75, 217, 85, 0,
+        98, 140, 229, 80, 118, 151, 117, 251, 103, 242, 81, 238, 172, 82, 110, 4,
+        227, 77, 243, 46, 12, 189, 34, 188, 200, 161, 68, 76, 171, 194, 57, 48,
+        247, 233, 51, 105, 5, 23, 42, 50, 216, 45, 239, 148, 249, 84, 70, 125,
+        108, 241, 62, 66, 64, 240, 173, 185, 250, 49, 6, 37, 26, 21, 244, 60,
+        223, 255, 16, 145, 27, 109, 58, 102, 142, 253, 120, 149, 160, 124, 156, 79,
+        186, 135, 127, 14, 121, 22, 65, 54, 153, 91, 213, 174, 24, 252, 131, 192,
+        190, 202, 208, 35, 94, 231, 56, 95, 183, 163, 111, 147, 25, 67, 36, 92,
+        236, 71, 166, 1, 187, 100, 130, 143, 237, 178, 158, 104, 184, 159, 177, 52,
+        214, 230, 119, 87, 114, 201, 179, 198, 3, 248, 182, 39, 11, 152, 196, 113,
+        20, 232, 69, 141, 207, 234, 53, 86, 180, 226, 74, 150, 218, 29, 133, 8,
+        44, 123, 28, 146, 89, 101, 154, 220, 126, 155, 61, 191, 18, 157, 55, 167,
+        122, 245, 246, 254, 210, 162, 168, 107, 199, 144, 209, 215, 235, 164, 33, 129,
+        };
+
+        // Gradient directions of FMath's Grad2, indexed by Hash & 7
+        const float GradientX[8] = { 1.0f, 1.0f, 0.0f, -1.0f, -1.0f, -1.0f, 0.0f, 1.0f };
+        const float GradientY[8] = { 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, -1.0f, -1.0f, -1.0f };
+
+        constexpr int32 BlockSize = 256;
+
+        FORCEINLINE int32 Perm(const int32 Index)
+        {
+            return Permutation[Index & 255];
+        }
+
+        FORCEINLINE float SmoothCurve(const float X)
+        {
+            return X * X * X * (X * (X * 6.0f - 15.0f) + 10.0f);
+        }
+
+        FORCEINLINE VectorRegister4Float SmoothCurve(const VectorRegister4Float X)
+        {
+            const VectorRegister4Float X3 = VectorMultiply(VectorMultiply(X, X), X);
+            const VectorRegister4Float Inner = VectorMultiplyAdd(X, VectorSetFloat1(6.0f), VectorSetFloat1(-15.0f));
+            return VectorMultiply(X3, VectorMultiplyAdd(X, Inner, VectorSetFloat1(10.0f)));
+        }
+
+        // 30 X^2 (X - 1)^2
+        FORCEINLINE float SmoothCurveDerivative(const float X)
+        {
+            const float XXm1 = X * (X - 1.0f);
+            return 30.0f * (XXm1 * XXm1);
+        }
+
+        FORCEINLINE VectorRegister4Float SmoothCurveDerivative(const VectorRegister4Float X)
+        {
+            const VectorRegister4Float XXm1 = VectorMultiply(X, VectorSubtract(X, VectorSetFloat1(1.0f)));
+            return VectorMultiply(VectorSetFloat1(30.0f), VectorMultiply(XXm1, XXm1));
+        }
+
+        // Everything that is constant along one row of samples
+        struct FRowState
+        {
+            int32 Yi;
+            float Y;
+            float Ym1;
+            float V;
+            float DV;
+        };
+
+        // Corner gradients of one lattice cell, with the Y terms folded in
+        struct FCell
+        {
+            float Gx00, Gx10, Gx01, Gx11;
+            float C00, C10, C01, C11;
+            float Gy00, Gy10, Gy01, Gy11;
+        };
+
+        FORCEINLINE FCell MakeCell(const FRowState& Row, const int32 Xi)
+        {
+            const int32 AA = Perm(Xi) + Row.Yi;
+            const int32 AB = AA + 1;
+            const int32 BA = Perm(Xi + 1) + Row.Yi;
+            const int32 BB = BA + 1;
+
+            const int32 H00 = Perm(AA) & 7;
+            const int32 H10 = Perm(BA) & 7;
+            const int32 H01 = Perm(AB) & 7;
+            const int32 H11 = Perm(BB) & 7;
+
+            FCell Cell;
+            Cell.Gx00 = GradientX[H00];
+            Cell.Gx10 = GradientX[H10];
+            Cell.Gx01 = GradientX[H01];
+            Cell.Gx11 = GradientX[H11];
+            Cell.C00 = GradientY[H00] * Row.Y;
+            Cell.C10 = GradientY[H10] * Row.Y;
+            Cell.C01 = GradientY[H01] * Row.Ym1;
+            Cell.C11 = GradientY[H11] * Row.Ym1;
+            Cell.Gy00 = GradientY[H00];
+            Cell.Gy10 = GradientY[H10];
+            Cell.Gy01 = GradientY[H01];
+            Cell.Gy11 = GradientY[H11];
+            return Cell;
+        }
+
+        FORCEINLINE float EvaluateCell(const FCell& Cell, const float V, const float X)
+        {
+            const float Xm1 = X - 1.0f;
+            const float U = SmoothCurve(X);
+
+            const float G00 = Cell.Gx00 * X + Cell.C00;
+            const float G10 = Cell.Gx10 * Xm1 + Cell.C10;
+            const float G01 = Cell.Gx01 * X + Cell.C01;
+            const float G11 = Cell.Gx11 * Xm1 + Cell.C11;
+
+            const float N0 = G00 + U * (G10 - G00);
+            const float N1 = G01 + U * (G11 - G01);
+            return N0 + V * (N1 - N0);
+        }
+
+        // Same value as EvaluateCell, along with its derivatives in noise coordinates
+        FORCEINLINE void EvaluateCellDerivatives(const FCell& Cell, const FRowState& Row, const float X, float& OutValue, float& OutDx, float& OutDy)
+        {
+            const float Xm1 = X - 1.0f;
+            const float U = SmoothCurve(X);
+            const float DU = SmoothCurveDerivative(X);
+
+            const float G00 = Cell.Gx00 * X + Cell.C00;
+            const float G10 = Cell.Gx10 * Xm1 + Cell.C10;
+            const float G01 = Cell.Gx01 * X + Cell.C01;
+            const float G11 = Cell.Gx11 * Xm1 + Cell.C11;
+
+            const float N0 = G00 + U * (G10 - G00);
+            const float N1 = G01 + U * (G11 - G01);
+            OutValue = N0 + Row.V * (N1 - N0);
+
+            const float DN0x = Cell.Gx00 + U * (Cell.Gx10 - Cell.Gx00) + DU * (G10 - G00);
+            const float DN1x = Cell.Gx01 + U * (Cell.Gx11 - Cell.Gx01) + DU * (G11 - G01);
+            OutDx = DN0x + Row.V * (DN1x - DN0x);
+
+            const float DN0y = Cell.Gy00 + U * (Cell.Gy10 - Cell.Gy00);
+            const float DN1y = Cell.Gy01 + U * (Cell.Gy11 - Cell.Gy01);
+            OutDy = DN0y + Row.V * (DN1y - DN0y) + Row.DV * (N1 - N0);
+        }
+
+        // Evaluates Xs[Begin, End), which all lie in the lattice cell starting at Xfl, four lanes at a time
+        void EvaluateSegment(const FCell& Cell, const float V, const float Xfl, const float* Xs, float* Result, const int32 Begin, const int32 End)
+        {
+            int32 i = Begin;
+
+            const VectorRegister4Float VXfl = VectorSetFloat1(Xfl);
+            const VectorRegister4Float VOne = VectorSetFloat1(1.0f);
+            const VectorRegister4Float VV = VectorSetFloat1(V);
+            const VectorRegister4Float Gx00 = VectorSetFloat1(Cell.Gx00);
+            const VectorRegister4Float Gx10 = VectorSetFloat1(Cell.Gx10);
+            const VectorRegister4Float Gx01 = VectorSetFloat1(Cell.Gx01);
+            const VectorRegister4Float Gx11 = VectorSetFloat1(Cell.Gx11);
+            const VectorRegister4Float C00 = VectorSetFloat1(Cell.C00);
+            const VectorRegister4Float C10 = VectorSetFloat1(Cell.C10);
+            const VectorRegister4Float C01 = VectorSetFloat1(Cell.C01);
+            const VectorRegister4Float C11 = VectorSetFloat1(Cell.C11);
+
+            for (; i + 4 <= End; i += 4)
+            {
+                const VectorRegister4Float X = VectorSubtract(VectorLoad(Xs + i), VXfl);
+                const VectorRegister4Float Xm1 = VectorSubtract(X, VOne);
+                const VectorRegister4Float U = SmoothCurve(X);
+
+                const VectorRegister4Float G00 = VectorMultiplyAdd(Gx00, X, C00);
+                const VectorRegister4Float G10 = VectorMultiplyAdd(Gx10, Xm1, C10);
+                const VectorRegister4Float G01 = VectorMultiplyAdd(Gx01, X, C01);
+                const VectorRegister4Float G11 = VectorMultiplyAdd(Gx11, Xm1, C11);
+
+                const VectorRegister4Float N0 = VectorMultiplyAdd(U, VectorSubtract(G10, G00), G00);
+                const VectorRegister4Float N1 = VectorMultiplyAdd(U, VectorSubtract(G11, G01), G01);
+                VectorStore(VectorMultiplyAdd(VV, VectorSubtract(N1, N0), N0), Result + i);
+            }
+
+            for (; i < End; ++i)
+            {
+                Result[i] = EvaluateCell(Cell, V, Xs[i] - Xfl);
+            }
+        }
+
+        void EvaluateSegmentDerivatives(const FCell& Cell, const FRowState& Row, const float Xfl, const float* Xs, float* Result, float* ResultDx, float* ResultDy, const int32 Begin, const int32 End)
+        {
+            int32 i = Begin;
+
+            const VectorRegister4Float VXfl = VectorSetFloat1(Xfl);
+            const VectorRegister4Float VOne = VectorSetFloat1(1.0f);
+            const VectorRegister4Float VV = VectorSetFloat1(Row.V);
+            const VectorRegister4Float VDV = VectorSetFloat1(Row.DV);
+            const VectorRegister4Float Gx00 = VectorSetFloat1(Cell.Gx00);
+            const VectorRegister4Float Gx10 = VectorSetFloat1(Cell.Gx10);
+            const VectorRegister4Float Gx01 = VectorSetFloat1(Cell.Gx01);
+            const VectorRegister4Float Gx11 = VectorSetFloat1(Cell.Gx11);
+            const VectorRegister4Float C00 = VectorSetFloat1(Cell.C00);
+            const VectorRegister4Float C10 = VectorSetFloat1(Cell.C10);
+            const VectorRegister4Float C01 = VectorSetFloat1(Cell.C01);
+            const VectorRegister4Float C11 = VectorSetFloat1(Cell.C11);
+            const VectorRegister4Float Gy00 = VectorSetFloat1(Cell.Gy00);
+            const VectorRegister4Float Gy01 = VectorSetFloat1(Cell.Gy01);
+            const VectorRegister4Float DGx0 = VectorSetFloat1(Cell.Gx10 - Cell.Gx00);
+            const VectorRegister4Float DGx1 = VectorSetFloat1(Cell.Gx11 - Cell.Gx01);
+            const VectorRegister4Float DGy0 = VectorSetFloat1(Cell.Gy10 - Cell.Gy00);
+            const VectorRegister4Float DGy1 = VectorSetFloat1(Cell.Gy11 - Cell.Gy01);
+
+            for (; i + 4 <= End; i += 4)
+            {
+                const VectorRegister4Float X = VectorSubtract(VectorLoad(Xs + i), VXfl);
+                const VectorRegister4Float Xm1 = VectorSubtract(X, VOne);
+                const VectorRegister4Float U = SmoothCurve(X);
+                const VectorRegister4Float DU = SmoothCurveDerivative(X);
+
+                const VectorRegister4Float G00 = VectorMultiplyAdd(Gx00, X, C00);
+                const VectorRegister4Float G10 = VectorMultiplyAdd(Gx10, Xm1, C10);
+                const VectorRegister4Float G01 = VectorMultiplyAdd(Gx01, X, C01);
+                const VectorRegister4Float G11 = VectorMultiplyAdd(Gx11, Xm1, C11);
+
+                const VectorRegister4Float N0 = VectorMultiplyAdd(U, VectorSubtract(G10, G00), G00);
+                const VectorRegister4Float N1 = VectorMultiplyAdd(U, VectorSubtract(G11, G01), G01);
+                const VectorRegister4Float N1mN0 = VectorSubtract(N1, N0);
+                VectorStore(VectorMultiplyAdd(VV, N1mN0, N0), Result + i);
+
+                const VectorRegister4Float DN0x = VectorMultiplyAdd(DU, VectorSubtract(G10, G00), VectorMultiplyAdd(U, DGx0, Gx00));
+                const VectorRegister4Float DN1x = VectorMultiplyAdd(DU, VectorSubtract(G11, G01), VectorMultiplyAdd(U, DGx1, Gx01));
+                VectorStore(VectorMultiplyAdd(VV, VectorSubtract(DN1x, DN0x), DN0x), ResultDx + i);
+
+                const VectorRegister4Float DN0y = VectorMultiplyAdd(U, DGy0, Gy00);
+                const VectorRegister4Float DN1y = VectorMultiplyAdd(U, DGy1, Gy01);
+                VectorStore(VectorMultiplyAdd(VDV, N1mN0, VectorMultiplyAdd(VV, VectorSubtract(DN1y, DN0y), DN0y)), ResultDy + i);
+            }
+
+            for (; i < End; ++i)
+            {
+                EvaluateCellDerivatives(Cell, Row, Xs[i] - Xfl, Result[i], ResultDx[i], ResultDy[i]);
+            }
+        }
+
+        FORCEINLINE FRowState MakeRow(const int32 Y, const double Frequency, const FVector2D Offset)
+        {
+            // Same float precision as FMath::PerlinNoise2D
+            const float SampleY = static_cast<float>(Y * Frequency + Offset.Y);
+            const float Yfl = FMath::FloorToFloat(SampleY);
+
+            FRowState Row;
+            Row.Yi = static_cast<int32>(Yfl) & 255;
+            Row.Y = SampleY - Yfl;
+            Row.Ym1 = Row.Y - 1.0f;
+            Row.V = SmoothCurve(Row.Y);
+            Row.DV = SmoothCurveDerivative(Row.Y);
+            return Row;
+        }
+
+        // Calls Segment(Cell, Xfl, Xs, Begin, End, BlockBegin) for every run of samples of a block in the same lattice cell
+        template<typename SegmentType>
+        FORCEINLINE void ForEachSegment(const FRowState& Row, const int32 BlockBegin, const int32 Count, const int32 FirstX, const double Frequency, const FVector2D Offset, float* Xs, SegmentType&& Segment)
+        {
+            for (int32 i = 0; i < Count; ++i)
+            {
+                Xs[i] = static_cast<float>((FirstX + BlockBegin + i) * Frequency + Offset.X);
+            }
+
+            // Consecutive samples usually share a lattice cell, so the hashing is done once per run
+            int32 i = 0;
+            while (i < Count)
+            {
+                const float Xfl = FMath::FloorToFloat(Xs[i]);
+                const float Xceil = Xfl + 1.0f;
+
+                int32 End = i + 1;
+                while (End < Count && Xs[End] >= Xfl && Xs[End] < Xceil)
+                {
+                    ++End;
+                }
+
+                Segment(MakeCell(Row, static_cast<int32>(Xfl) & 255), Xfl, i, End);
+                i = End;
+            }
+        }
+
+        template<typename ScalarType>
+        void ProcessRowDerivatives(ScalarType* Out, ScalarType* OutDx, ScalarType* OutDy, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+        {
+            const FRowState Row = MakeRow(Y, Frequency, Offset);
+
+            alignas(16) float Xs[BlockSize];
+            alignas(16) float Result[BlockSize];
+            alignas(16) float ResultDx[BlockSize];
+            alignas(16) float ResultDy[BlockSize];
+
+            // Noise coordinates move by Frequency per sample, so the derivatives along the samples are scaled by it
+            const ScalarType OutAmplitude = static_cast<ScalarType>(Amplitude);
+            const ScalarType OutDerivativeScale = static_cast<ScalarType>(Amplitude * Frequency);
+
+            for (int32 BlockBegin = 0; BlockBegin < Num; BlockBegin += BlockSize)
+            {
+                const int32 Count = FMath::Min(BlockSize, Num - BlockBegin);
+                ForEachSegment(Row, BlockBegin, Count, FirstX, Frequency, Offset, Xs, [&](const FCell& Cell, const float Xfl, const int32 Begin, const int32 End)
+                {
+                    EvaluateSegmentDerivatives(Cell, Row, Xfl, Xs, Result, ResultDx, ResultDy, Begin, End);
+                });
+
+                for (int32 j = 0; j < Count; ++j)
+                {
+                    Out[BlockBegin + j] = Result[j] * OutAmplitude;
+                    OutDx[BlockBegin + j] = ResultDx[j] * OutDerivativeScale;
+                    OutDy[BlockBegin + j] = ResultDy[j] * OutDerivativeScale;
+                }
+            }
+        }
+
+        template<bool bAccumulate, typename ScalarType>
+        void ProcessRow(ScalarType* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+        {
+            const FRowState Row = MakeRow(Y, Frequency, Offset);
+
+            alignas(16) float Xs[BlockSize];
+            alignas(16) float Result[BlockSize];
+
+            for (int32 BlockBegin = 0; BlockBegin < Num; BlockBegin += BlockSize)
+            {
+                const int32 Count = FMath::Min(BlockSize, Num - BlockBegin);
+                ForEachSegment(Row, BlockBegin, Count, FirstX, Frequency, Offset, Xs, [&](const FCell& Cell, const float Xfl, const int32 Begin, const int32 End)
+                {
+                    EvaluateSegment(Cell, Row.V, Xfl, Xs, Result, Begin, End);
+                });
+
+                // The amplitude is applied in the output precision
+                const ScalarType OutAmplitude = static_cast<ScalarType>(Amplitude);
+                ScalarType* OutBlock = Out + BlockBegin;
+                for (int32 j = 0; j < Count; ++j)
+                {
+                    if constexpr (bAccumulate)
+                    {
+                        OutBlock[j] += Result[j] * OutAmplitude;
+                    }
+                    else
+                    {
+                        OutBlock[j] = Result[j] * OutAmplitude;
+                    }
+                }
+            }
+        }
+    }
+
+    void SampleRow(float* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+    {
+        ProcessRow<false>(Out, Num, FirstX, Y, Frequency, Offset, Amplitude);
+    }
+
+    void SampleRow(double* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+    {
+        ProcessRow<false>(Out, Num, FirstX, Y, Frequency, Offset, Amplitude);
+    }
+
+    void AccumulateRow(float* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+    {
+        ProcessRow<true>(Out, Num, FirstX, Y, Frequency, Offset, Amplitude);
+    }
+
+    void AccumulateRow(double* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+    {
+        ProcessRow<true>(Out, Num, FirstX, Y, Frequency, Offset, Amplitude);
+    }
+
+    void SampleRowWithDerivatives(float* Out, float* OutDx, float* OutDy, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+    {
+        ProcessRowDerivatives(Out, OutDx, OutDy, Num, FirstX, Y, Frequency, Offset, Amplitude);
+    }
+
+    void SampleRowWithDerivatives(double* Out, double* OutDx, double* OutDy, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude)
+    {
+        ProcessRowDerivatives(Out, OutDx, OutDy, Num, FirstX, Y, Frequency, Offset, Amplitude);
+    }
+
+    double MeasureMaxError(const int32 NumRows, const int32 RowLength, const int32 Seed)
+    {
+        FRandomStream RandomStream(Seed);
+        TArray<double> Samples;
+        Samples.SetNumUninitialized(RowLength);
+
+        double MaxError = 0.0;
+        for (int32 r = 0; r < NumRows; ++r)
+        {
+            // Cover both the frequencies used by the biomes and ones that change cell on every sample
+            const double Frequency = FMath::Pow(10.0, static_cast<double>(RandomStream.FRandRange(-3.0f, 0.5f)));
+            const FVector2D Offset(RandomStream.FRandRange(-100000.0f, 100000.0f), RandomStream.FRandRange(-100000.0f, 100000.0f));
+            const int32 Y = RandomStream.RandRange(0, 8192);
+
+            SampleRow(Samples.GetData(), RowLength, 0, Y, Frequency, Offset);
+
+            for (int32 x = 0; x < RowLength; ++x)
+            {
+                const double Reference = FMath::PerlinNoise2D(FVector2D(x * Frequency + Offset.X, Y * Frequency + Offset.Y));
+                MaxError = FMath::Max(MaxError, FMath::Abs(Samples[x] - Reference));
+            }
+        }
+
+        return MaxError;
+    }
+
+    double MeasureMaxDerivativeError(const int32 NumRows, const int32 RowLength, const int32 Seed)
+    {
+        FRandomStream RandomStream(Seed);
+        TArray<double> Samples;
+        TArray<double> Dx;
+        TArray<double> Dy;
+        Samples.SetNumUninitialized(RowLength);
+        Dx.SetNumUninitialized(RowLength);
+        Dy.SetNumUninitialized(RowLength);
+
+        double MaxError = 0.0;
+        for (int32 r = 0; r < NumRows; ++r)
+        {
+            const double Frequency = FMath::Pow(10.0, static_cast<double>(RandomStream.FRandRange(-3.0f, -1.0f)));
+            const FVector2D Offset(RandomStream.FRandRange(-1000.0f, 1000.0f), RandomStream.FRandRange(-1000.0f, 1000.0f));
+            const int32 Y = RandomStream.RandRange(1, 8192);
+
+            SampleRowWithDerivatives(Samples.GetData(), Dx.GetData(), Dy.GetData(), RowLength, 0, Y, Frequency, Offset);
+
+            // The derivatives come out per sample, the differences are taken in noise coordinates
+            constexpr double Step = 1.0e-2;
+            for (int32 x = 0; x < RowLength; ++x)
+            {
+                const double SampleX = x * Frequency + Offset.X;
+                const double SampleY = Y * Frequency + Offset.Y;
+                const double ReferenceDx = (FMath::PerlinNoise2D(FVector2D(SampleX + Step, SampleY)) - FMath::PerlinNoise2D(FVector2D(SampleX - Step, SampleY))) / (2.0 * Step);
+                const double ReferenceDy = (FMath::PerlinNoise2D(FVector2D(SampleX, SampleY + Step)) - FMath::PerlinNoise2D(FVector2D(SampleX, SampleY - Step))) / (2.0 * Step);
+                MaxError = FMath::Max(MaxError, FMath::Abs(Dx[x] / Frequency - ReferenceDx));
+                MaxError = FMath::Max(MaxError, FMath::Abs(Dy[x] / Frequency - ReferenceDy));
+            }
+        }
+
+        return MaxError;
+    }
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPerlinNoiseMatchesEngineTest, "AutoWorldGen.PerlinNoise.MatchesEngine", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FPerlinNoiseMatchesEngineTest::RunTest(const FString& Parameters)
+{
+    // Both evaluate the same float operations, only the order of a few additions can differ
+    const double MaxError = PerlinNoise::MeasureMaxError();
+    TestTrue(*FString::Printf(TEXT("Max error %g against FMath::PerlinNoise2D is within 1e-5"), MaxError), MaxError <= 1.0e-5);
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPerlinNoiseDerivativesTest, "AutoWorldGen.PerlinNoise.Derivatives", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FPerlinNoiseDerivativesTest::RunTest(const FString& Parameters)
+{
+    // Central differences of float noise are only good to a few thousandths, a wrong derivative is off by far more
+    const double MaxError = PerlinNoise::MeasureMaxDerivativeError();
+    TestTrue(*FString::Printf(TEXT("Max derivative error %g against central differences is within 2e-2"), MaxError), MaxError <= 2.0e-2);
+    return true;
+}
+
+#endif
@@ -0,0 +1,31 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Batched 2D Perlin noise that matches FMath::PerlinNoise2D (the engine's permutation table from UnrealMath.cpp,
+ * its gradients and float precision), evaluated a whole row of samples at a time, 4 per VectorRegister4Float.
+ * Sample i of a row is taken at ((FirstX + i) * Frequency + Offset.X, Y * Frequency + Offset.Y).
+ */
+namespace PerlinNoise
+{
+	// Out[i] = Noise * Amplitude
+	void SampleRow(float* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude = 1.0);
+	void SampleRow(double* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude = 1.0);
+
+	// Out[i] += Noise * Amplitude
+	void AccumulateRow(float* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude = 1.0);
+	void AccumulateRow(double* Out, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude = 1.0);
+
+	// Out[i] = Noise * Amplitude, OutDx[i] and OutDy[i] = its analytic derivatives along the samples, x and y
+	void SampleRowWithDerivatives(float* Out, float* OutDx, float* OutDy, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude = 1.0);
+	void SampleRowWithDerivatives(double* Out, double* OutDx, double* OutDy, const int32 Num, const int32 FirstX, const int32 Y, const double Frequency, const FVector2D Offset, const double Amplitude = 1.0);
+
+	// Largest absolute difference to FMath::PerlinNoise2D over NumRows random rows of RowLength samples
+	double MeasureMaxError(const int32 NumRows = 256, const int32 RowLength = 1024, const int32 Seed = 0);
+
+	// Largest difference of the derivatives to central differences of FMath::PerlinNoise2D, in noise coordinates
+	double MeasureMaxDerivativeError(const int32 NumRows = 64, const int32 RowLength = 1024, const int32 Seed = 0);
+}
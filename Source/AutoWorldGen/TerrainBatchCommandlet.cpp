@@ -0,0 +1,231 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainBatchCommandlet.h"
+#include "BiomePreset.h"
+#include "TerrainGenerator.h"
+#include "TerrainErosion.h"
+#include "TerrainTileSink.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+
+#include <atomic>
+
+namespace
+{
+    struct FBatchJob
+    {
+        FString BiomesPath;
+        FString OutputPath;
+        int32 WorldSize = 0;
+        bool bOverrideSeed = false;
+        int32 Seed = 0;
+    };
+
+    bool ReadManifest(const FString& ManifestPath, const FString& OutputDir, TArray<FBatchJob>& OutJobs)
+    {
+        FString JsonString;
+        if (!FFileHelper::LoadFileToString(JsonString, *ManifestPath))
+        {
+            UE_LOG(LogTemp, Error, TEXT("Failed to read %s."), *ManifestPath);
+            return false;
+        }
+
+        TSharedPtr<FJsonObject> RootObject;
+        TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(JsonString);
+        const TArray<TSharedPtr<FJsonValue>>* JobArray = nullptr;
+        if (!FJsonSerializer::Deserialize(Reader, RootObject) || !RootObject.IsValid() || !RootObject->TryGetArrayField(TEXT("Jobs"), JobArray))
+        {
+            UE_LOG(LogTemp, Error, TEXT("%s has no Jobs array."), *ManifestPath);
+            return false;
+        }
+
+        const FString ManifestDir = FPaths::GetPath(ManifestPath);
+        for (int32 i = 0; i < JobArray->Num(); i++)
+        {
+            const TSharedPtr<FJsonObject> JobObject = (*JobArray)[i]->AsObject();
+
+            FBatchJob Job;
+            FString BiomesPath;
+            if (!JobObject.IsValid() || !JobObject->TryGetStringField(TEXT("Biomes"), BiomesPath) || !JobObject->TryGetNumberField(TEXT("WorldSize"), Job.WorldSize) || Job.WorldSize < 2)
+            {
+                UE_LOG(LogTemp, Error, TEXT("Job %d of %s needs Biomes and a WorldSize of at least 2."), i, *ManifestPath);
+                return false;
+            }
+            Job.BiomesPath = FPaths::ConvertRelativePathToFull(ManifestDir, BiomesPath);
+            Job.bOverrideSeed = JobObject->TryGetNumberField(TEXT("Seed"), Job.Seed);
+
+            FString OutputPath;
+            Job.OutputPath = JobObject->TryGetStringField(TEXT("Output"), OutputPath)
+                ? FPaths::ConvertRelativePathToFull(ManifestDir, OutputPath)
+                : OutputDir / FString::Printf(TEXT("Job%d.r16"), i);
+
+            OutJobs.Add(MoveTemp(Job));
+        }
+
+        return true;
+    }
+
+    // Same settings as the erosion of AAutoWorldGenCore, anything not given keeps its default
+    void ParseErosionSettings(const FString& Params, FTerrainErosionSettings& OutSettings)
+    {
+        FParse::Value(*Params, TEXT("HydraulicIterations="), OutSettings.HydraulicIterations);
+        FParse::Value(*Params, TEXT("RainAmount="), OutSettings.RainAmount);
+        FParse::Value(*Params, TEXT("EvaporationRate="), OutSettings.EvaporationRate);
+        FParse::Value(*Params, TEXT("SedimentCapacity="), OutSettings.SedimentCapacity);
+        FParse::Value(*Params, TEXT("ErosionRate="), OutSettings.ErosionRate);
+        FParse::Value(*Params, TEXT("DepositionRate="), OutSettings.DepositionRate);
+        FParse::Value(*Params, TEXT("ThermalIterations="), OutSettings.ThermalIterations);
+        FParse::Value(*Params, TEXT("TalusSlope="), OutSettings.TalusSlope);
+        FParse::Value(*Params, TEXT("ThermalRate="), OutSettings.ThermalRate);
+    }
+
+    // Moves the first biome to Seed and the others by the same amount, so their seeds stay apart
+    void OverrideSeed(TArray<FBiome>& Biomes, const int32 Seed)
+    {
+        if (Biomes.Num() == 0)
+        {
+            return;
+        }
+
+        const int32 Shift = Seed - Biomes[0].Seed;
+        for (FBiome& Biome : Biomes)
+        {
+            Biome.Seed += Shift;
+        }
+    }
+}
+
+UTerrainBatchCommandlet::UTerrainBatchCommandlet()
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+int32 UTerrainBatchCommandlet::Main(const FString& Params)
+{
+    FString ManifestPath;
+    FString OutputDir = FPaths::ProjectSavedDir() / TEXT("AutoWorldGen") / TEXT("Batch");
+    int32 NumWorkers = 4;
+    int32 MemoryBudgetMB = 4096;
+    double WeightEpsilon = 0.0;
+    FHeightQuantization Quantization;
+    FTerrainErosionSettings Erosion;
+
+    FParse::Value(*Params, TEXT("Manifest="), ManifestPath);
+    FParse::Value(*Params, TEXT("OutputDir="), OutputDir);
+    FParse::Value(*Params, TEXT("Workers="), NumWorkers);
+    FParse::Value(*Params, TEXT("MemoryBudgetMB="), MemoryBudgetMB);
+    FParse::Value(*Params, TEXT("WeightEpsilon="), WeightEpsilon);
+    FParse::Value(*Params, TEXT("HeightOffset="), Quantization.Offset);
+    FParse::Value(*Params, TEXT("HeightScale="), Quantization.Scale);
+    ParseErosionSettings(Params, Erosion);
+
+    TArray<FBatchJob> Jobs;
+    if (ManifestPath.IsEmpty() || !ReadManifest(ManifestPath, OutputDir, Jobs))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Usage: -run=TerrainBatch -Manifest=<path> [-Workers=4] [-MemoryBudgetMB=4096] [-WeightEpsilon=0] [-HeightOffset=256] [-HeightScale=128] [-HydraulicIterations=0] [-ThermalIterations=0] [-OutputDir=<dir>]"));
+        return 1;
+    }
+    if (Quantization.Scale <= 0.0)
+    {
+        UE_LOG(LogTemp, Error, TEXT("HeightScale has to be positive."));
+        return 1;
+    }
+    if (Jobs.Num() == 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("%s has no jobs."), *ManifestPath);
+        return 0;
+    }
+
+    // Every preset is loaded once up front, many jobs usually share one
+    TMap<FString, TArray<FBiome>> Presets;
+    for (const FBatchJob& Job : Jobs)
+    {
+        if (Presets.Contains(Job.BiomesPath))
+        {
+            continue;
+        }
+
+        TArray<FBiome> Biomes;
+        if (!BiomePreset::Load(Job.BiomesPath, Biomes) || Biomes.Num() == 0)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Failed to load biomes from %s."), *Job.BiomesPath);
+            return 1;
+        }
+        Presets.Add(Job.BiomesPath, MoveTemp(Biomes));
+    }
+
+    // Each worker streams one world at a time and gets an equal share of the budget and of the threads.
+    // The heights do not depend on the number of threads.
+    NumWorkers = FMath::Clamp(NumWorkers, 1, Jobs.Num());
+    const int64 WorkerMemoryBudget = static_cast<int64>(FMath::Max(MemoryBudgetMB, 1)) * 1024 * 1024 / NumWorkers;
+    const int32 ThreadsPerWorker = FMath::Max(1, (FTaskGraphInterface::Get().GetNumWorkerThreads() + 1) / NumWorkers);
+
+    UE_LOG(LogTemp, Display, TEXT("Generating %d worlds on %d workers with %d threads and %lld MB each."),
+        Jobs.Num(), NumWorkers, ThreadsPerWorker, WorkerMemoryBudget / (1024 * 1024));
+    if (Erosion.IsEnabled())
+    {
+        UE_LOG(LogTemp, Display, TEXT("Eroding every world with %d hydraulic and %d thermal iterations, whole worlds are kept in memory regardless of the budget."),
+            Erosion.HydraulicIterations, Erosion.ThermalIterations);
+    }
+
+    TArray<bool> Succeeded;
+    Succeeded.SetNumZeroed(Jobs.Num());
+    std::atomic<int32> NextJob{ 0 };
+    const double StartTime = FPlatformTime::Seconds();
+
+    ParallelFor(NumWorkers, [&](const int32 Worker)
+    {
+        // Workers take the next job as soon as they are done, so uneven world sizes still balance out
+        for (int32 JobIndex = NextJob++; JobIndex < Jobs.Num(); JobIndex = NextJob++)
+        {
+            const FBatchJob& Job = Jobs[JobIndex];
+            const double JobStartTime = FPlatformTime::Seconds();
+
+            TArray<FBiome> Biomes = Presets[Job.BiomesPath];
+            if (Job.bOverrideSeed)
+            {
+                OverrideSeed(Biomes, Job.Seed);
+            }
+
+            FTerrainGenerator Generator(Biomes, Job.WorldSize, ThreadsPerWorker);
+            Generator.SetWeightEpsilon(WeightEpsilon);
+
+            const FIntPoint Size(Job.WorldSize, Job.WorldSize);
+            FRawHeightmapSink Sink(Job.OutputPath, Size);
+            Sink.SetQuantization(Quantization);
+            if (!Erosion.IsEnabled())
+            {
+                Succeeded[JobIndex] = Sink.IsValid() && Generator.GenerateStreamed(Size, WorkerMemoryBudget, 1, Sink);
+            }
+            else if (Sink.IsValid())
+            {
+                // Erosion needs the whole heightfield, so the world is generated in one piece as in the editor
+                const FIntRect Region(0, 0, Job.WorldSize, Job.WorldSize);
+                FTerrainGenerator::FMatrix Heights = Generator.Generate(Region);
+                Succeeded[JobIndex] = FTerrainErosion(Erosion, ThreadsPerWorker).Erode(Heights) && Sink.WriteTile(Region, Heights);
+            }
+
+            UE_LOG(LogTemp, Display, TEXT("[%d/%d] %s %s in %.1f s."), JobIndex + 1, Jobs.Num(),
+                Succeeded[JobIndex] ? TEXT("Wrote") : TEXT("Failed to write"), *Job.OutputPath, FPlatformTime::Seconds() - JobStartTime);
+        }
+    }, EParallelForFlags::Unbalanced);
+
+    int32 NumFailed = 0;
+    for (const bool bSucceeded : Succeeded)
+    {
+        NumFailed += bSucceeded ? 0 : 1;
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Generated %d of %d worlds in %.1f s."), Jobs.Num() - NumFailed, Jobs.Num(), FPlatformTime::Seconds() - StartTime);
+    return NumFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+
+#include "TerrainBatchCommandlet.generated.h"
+
+/**
+ * Generates every job of a manifest into raw 16 bit heightmaps (.r16) without the editor UI.
+ * Jobs run concurrently on Workers workers, each streaming its world in bands so all of them
+ * together stay below MemoryBudgetMB.
+ * With erosion iterations every world is generated and eroded whole, the same heights the editor
+ * produces with those erosion settings. Those jobs keep their whole world in memory.
+ *
+ * UnrealEditor-Cmd AutoWorldGen.uproject -run=TerrainBatch -Manifest=Jobs.json -unattended -nullrhi
+ *     [-Workers=4] [-MemoryBudgetMB=4096] [-WeightEpsilon=0] [-HeightOffset=256] [-HeightScale=128]
+ *     [-HydraulicIterations=0] [-RainAmount=0.01] [-EvaporationRate=0.02] [-SedimentCapacity=1]
+ *     [-ErosionRate=0.3] [-DepositionRate=0.3] [-ThermalIterations=0] [-TalusSlope=0.7] [-ThermalRate=0.5]
+ *     [-OutputDir=Saved/AutoWorldGen/Batch]
+ *
+ * The manifest lists the jobs, paths are relative to the manifest:
+ * { "Jobs": [ { "Biomes": "Biomes.json", "WorldSize": 4096, "Seed": 7, "Output": "Variant7.r16" } ] }
+ * Seed is optional and moves the first biome to that seed, the other biomes keep their distance to it.
+ * Output is optional and defaults to Job<index>.r16 in OutputDir.
+ */
+UCLASS()
+class UTerrainBatchCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTerrainBatchCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,265 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainBenchmarkCommandlet.h"
+#include "BiomePreset.h"
+#include "TerrainGenerator.h"
+#include "TerrainErosion.h"
+
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+
+#include <atomic>
+
+namespace
+{
+    // Forwards everything to the engine allocator and counts the allocations on the way
+    class FCountingMalloc final : public FMalloc
+    {
+    public:
+        explicit FCountingMalloc(FMalloc* InInner) : Inner(InInner) {}
+
+        virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+        {
+            NumAllocations.fetch_add(1, std::memory_order_relaxed);
+            AllocatedBytes.fetch_add(Count, std::memory_order_relaxed);
+            return Inner->Malloc(Count, Alignment);
+        }
+
+        virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+        {
+            if (Count > 0)
+            {
+                NumAllocations.fetch_add(1, std::memory_order_relaxed);
+                AllocatedBytes.fetch_add(Count, std::memory_order_relaxed);
+            }
+            return Inner->Realloc(Original, Count, Alignment);
+        }
+
+        virtual void Free(void* Original) override { Inner->Free(Original); }
+        virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+        virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+        virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+        virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+        virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+        virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+        virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+        virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+        FMalloc* Inner;
+        std::atomic<uint64> NumAllocations{ 0 };
+        std::atomic<uint64> AllocatedBytes{ 0 };
+    };
+
+    struct FStageResult
+    {
+        double Seconds = 0.0;
+        uint64 NumAllocations = 0;
+        uint64 AllocatedBytes = 0;
+        // Set for the stages that run a number of iterations
+        int32 NumIterations = 0;
+    };
+
+    template<typename FuncType>
+    FStageResult MeasureStage(const FCountingMalloc& Counter, FuncType&& Func)
+    {
+        const uint64 NumAllocationsBefore = Counter.NumAllocations.load();
+        const uint64 AllocatedBytesBefore = Counter.AllocatedBytes.load();
+        const double StartTime = FPlatformTime::Seconds();
+
+        Func();
+
+        FStageResult Result;
+        Result.Seconds = FPlatformTime::Seconds() - StartTime;
+        Result.NumAllocations = Counter.NumAllocations.load() - NumAllocationsBefore;
+        Result.AllocatedBytes = Counter.AllocatedBytes.load() - AllocatedBytesBefore;
+        return Result;
+    }
+
+    TSharedPtr<FJsonObject> StageToJson(const FStageResult& Stage, const int64 NumSamples)
+    {
+        TSharedPtr<FJsonObject> StageObject = MakeShareable(new FJsonObject);
+        StageObject->SetNumberField(TEXT("Seconds"), Stage.Seconds);
+        StageObject->SetNumberField(TEXT("SamplesPerSecond"), Stage.Seconds > 0.0 ? NumSamples / Stage.Seconds : 0.0);
+        StageObject->SetNumberField(TEXT("Allocations"), static_cast<double>(Stage.NumAllocations));
+        StageObject->SetNumberField(TEXT("AllocatedBytes"), static_cast<double>(Stage.AllocatedBytes));
+        if (Stage.NumIterations > 0)
+        {
+            StageObject->SetNumberField(TEXT("Iterations"), Stage.NumIterations);
+            StageObject->SetNumberField(TEXT("MillisecondsPerIteration"), Stage.Seconds * 1000.0 / Stage.NumIterations);
+        }
+        return StageObject;
+    }
+
+    // Erodes a copy of Heights, so every erosion stage starts from the same generated terrain
+    FStageResult MeasureErosion(const FCountingMalloc& Counter, const FTerrainGenerator::FMatrix& Heights, const FTerrainErosionSettings& Settings, const int32 NumThreads)
+    {
+        FTerrainGenerator::FMatrix ErodedHeights = Heights;
+        const FTerrainErosion Erosion(Settings, NumThreads);
+        FStageResult Result = MeasureStage(Counter, [&]()
+        {
+            Erosion.Erode(ErodedHeights);
+        });
+        Result.NumIterations = Settings.HydraulicIterations + Settings.ThermalIterations;
+        return Result;
+    }
+
+    TSharedPtr<FJsonObject> RunBenchmark(const TArray<FBiome>& Biomes, const int32 WorldSize, const int32 NumThreads, const double WeightEpsilon,
+        const int32 ErosionIterations, const FCountingMalloc& Counter)
+    {
+        typedef FTerrainGenerator::FMatrix FMatrix;
+
+        const FIntRect Region(0, 0, WorldSize, WorldSize);
+        const int64 NumSamples = static_cast<int64>(WorldSize) * WorldSize;
+        FTerrainGenerator Generator(Biomes, WorldSize, NumThreads);
+        Generator.SetWeightEpsilon(WeightEpsilon);
+
+        const int32 BiomeNum = Biomes.Num();
+        TArray<FMatrix> NoiseMaps;
+        FMatrix Heights;
+        TArray<uint16> HeightData;
+        NoiseMaps.SetNum(BiomeNum);
+
+        // The stages run one after another, each of them parallel on its own, the same work Generate schedules
+        TArray<TPair<FString, FStageResult>> Stages;
+
+        Stages.Emplace(TEXT("Noise"), MeasureStage(Counter, [&]()
+        {
+            for (int32 i = 0; i < BiomeNum; i++)
+            {
+                NoiseMaps[i] = Generator.GetNoiseMap(Biomes[i], Generator.GetBiomeSupport(i, Region));
+            }
+        }));
+
+        Stages.Emplace(TEXT("Blend"), MeasureStage(Counter, [&]()
+        {
+            for (int32 i = 0; i < BiomeNum; i++)
+            {
+                Generator.BlendBiome(Heights, i, Region, NoiseMaps[i]);
+            }
+        }));
+        NoiseMaps.Empty();
+
+        // Same conversion CreateLandscape does before the import
+        Stages.Emplace(TEXT("Quantize"), MeasureStage(Counter, [&]()
+        {
+            HeightData.SetNumUninitialized(static_cast<int32>(NumSamples));
+            Generator.Quantize(Heights, WorldSize, EHeightResampling::None, FHeightQuantization(), HeightData.GetData());
+        }));
+        Heights.Reset();
+        HeightData.Empty();
+
+        // The whole pipeline as the actor runs it, with the stages overlapping as tasks
+        Stages.Emplace(TEXT("Generate"), MeasureStage(Counter, [&]()
+        {
+            Heights = Generator.Generate(Region);
+        }));
+
+        // Each kind of erosion on its own with the default rates, timed per iteration
+        if (ErosionIterations > 0)
+        {
+            FTerrainErosionSettings HydraulicSettings;
+            HydraulicSettings.HydraulicIterations = ErosionIterations;
+            Stages.Emplace(TEXT("HydraulicErosion"), MeasureErosion(Counter, Heights, HydraulicSettings, NumThreads));
+
+            FTerrainErosionSettings ThermalSettings;
+            ThermalSettings.ThermalIterations = ErosionIterations;
+            Stages.Emplace(TEXT("ThermalErosion"), MeasureErosion(Counter, Heights, ThermalSettings, NumThreads));
+        }
+        Heights.Reset();
+
+        TSharedPtr<FJsonObject> StagesObject = MakeShareable(new FJsonObject);
+        for (const TPair<FString, FStageResult>& Stage : Stages)
+        {
+            StagesObject->SetObjectField(Stage.Key, StageToJson(Stage.Value, NumSamples));
+        }
+
+        TSharedPtr<FJsonObject> ResultObject = MakeShareable(new FJsonObject);
+        ResultObject->SetNumberField(TEXT("WorldSize"), WorldSize);
+        ResultObject->SetNumberField(TEXT("Samples"), static_cast<double>(NumSamples));
+        // Peak of the whole process so far, so it only grows over the sizes
+        ResultObject->SetNumberField(TEXT("PeakUsedPhysical"), static_cast<double>(FPlatformMemory::GetStats().PeakUsedPhysical));
+        ResultObject->SetObjectField(TEXT("Stages"), StagesObject);
+        return ResultObject;
+    }
+}
+
+UTerrainBenchmarkCommandlet::UTerrainBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+}
+
+int32 UTerrainBenchmarkCommandlet::Main(const FString& Params)
+{
+    FString BiomesPath = FPaths::ProjectContentDir() + TEXT("Biomes.json");
+    FString SizesParam = TEXT("1024");
+    FString OutputPath = FPaths::ProjectSavedDir() / TEXT("AutoWorldGen") / TEXT("Benchmark.json");
+    int32 NumThreads = 0;
+    double WeightEpsilon = 0.0;
+    int32 ErosionIterations = 10;
+
+    FParse::Value(*Params, TEXT("Biomes="), BiomesPath);
+    FParse::Value(*Params, TEXT("Sizes="), SizesParam, false);
+    FParse::Value(*Params, TEXT("Output="), OutputPath);
+    FParse::Value(*Params, TEXT("Threads="), NumThreads);
+    FParse::Value(*Params, TEXT("WeightEpsilon="), WeightEpsilon);
+    FParse::Value(*Params, TEXT("ErosionIterations="), ErosionIterations);
+
+    TArray<FBiome> Biomes;
+    if (!BiomePreset::Load(BiomesPath, Biomes) || Biomes.Num() == 0)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Failed to load biomes from %s."), *BiomesPath);
+        return 1;
+    }
+
+    TArray<FString> SizeStrings;
+    SizesParam.ParseIntoArray(SizeStrings, TEXT(","));
+
+    // Only installed while the benchmarks run. Static, other threads may still be inside one of its calls after
+    // the previous allocator is back.
+    FMalloc* const PreviousMalloc = GMalloc;
+    static FCountingMalloc Counter(PreviousMalloc);
+    GMalloc = &Counter;
+
+    TArray<TSharedPtr<FJsonValue>> ResultArray;
+    for (const FString& SizeString : SizeStrings)
+    {
+        const int32 WorldSize = FCString::Atoi(*SizeString);
+        if (WorldSize < 2)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Skipping invalid world size %s."), *SizeString);
+            continue;
+        }
+
+        UE_LOG(LogTemp, Display, TEXT("Benchmarking %dx%d..."), WorldSize, WorldSize);
+        ResultArray.Add(MakeShareable(new FJsonValueObject(RunBenchmark(Biomes, WorldSize, NumThreads, WeightEpsilon, ErosionIterations, Counter))));
+    }
+    GMalloc = PreviousMalloc;
+
+    TSharedPtr<FJsonObject> RootObject = MakeShareable(new FJsonObject);
+    RootObject->SetStringField(TEXT("Biomes"), BiomesPath);
+    RootObject->SetStringField(TEXT("Precision"), AUTOWORLDGEN_DOUBLE_PRECISION ? TEXT("double") : TEXT("float"));
+    RootObject->SetNumberField(TEXT("NumThreads"), NumThreads);
+    RootObject->SetNumberField(TEXT("WeightEpsilon"), WeightEpsilon);
+    RootObject->SetNumberField(TEXT("ErosionIterations"), ErosionIterations);
+    RootObject->SetArrayField(TEXT("Results"), ResultArray);
+
+    FString OutputString;
+    TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&OutputString);
+    if (!FJsonSerializer::Serialize(RootObject.ToSharedRef(), Writer) || !FFileHelper::SaveStringToFile(OutputString, *OutputPath))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Failed to write %s."), *OutputPath);
+        return 1;
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("Wrote benchmark results to %s."), *OutputPath);
+    return 0;
+}
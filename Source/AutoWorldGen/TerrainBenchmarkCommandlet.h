@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+
+#include "TerrainBenchmarkCommandlet.generated.h"
+
+/**
+ * Times every stage of the terrain generation without spawning a landscape and writes the results as JSON.
+ * Biomes can be a JSON or a binary (.biomes) preset. Hydraulic and thermal erosion are timed on the generated
+ * heights and also report milliseconds per iteration, use -Sizes=4096,8192 for the large worlds.
+ *
+ * UnrealEditor-Cmd AutoWorldGen.uproject -run=TerrainBenchmark -Sizes=1024,2048,4096
+ *     [-Biomes=Content/Biomes.json] [-Threads=0] [-WeightEpsilon=0] [-ErosionIterations=10] [-Output=Saved/AutoWorldGen/Benchmark.json]
+ */
+UCLASS()
+class UTerrainBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTerrainBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,271 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainCellCache.h"
+
+#include "Misc/AutomationTest.h"
+
+FTerrainCellCache::FTerrainCellCache(const FTerrainCellSettings& InSettings)
+    : Settings(InSettings)
+{
+    Settings.CellQuads = FMath::Max(Settings.CellQuads, 1);
+
+    FTerrainGenerator CellGenerator(Settings.Biomes, Settings.WorldSize, 1);
+    CellGenerator.SetWeightEpsilon(Settings.WeightEpsilon);
+    Generator = MakeShared<const FTerrainGenerator>(MoveTemp(CellGenerator));
+
+    // Two triangles per quad, wound to face up
+    const int32 CellQuads = Settings.CellQuads;
+    const int32 NumVertsX = CellQuads + 1;
+    Triangles.Reserve(CellQuads * CellQuads * 6);
+    for (int32 y = 0; y < CellQuads; y++)
+    {
+        for (int32 x = 0; x < CellQuads; x++)
+        {
+            const int32 Index = y * NumVertsX + x;
+            Triangles.Add(Index + 1);
+            Triangles.Add(Index + NumVertsX);
+            Triangles.Add(Index);
+            Triangles.Add(Index + 1);
+            Triangles.Add(Index + NumVertsX + 1);
+            Triangles.Add(Index + NumVertsX);
+        }
+    }
+}
+
+FTerrainCellCache::~FTerrainCellCache()
+{
+    WaitForPending();
+}
+
+TSharedPtr<const FTerrainCell> FTerrainCellCache::Find(const FIntPoint& Coord)
+{
+    FCachedCell* Cached = Cells.Find(Coord);
+    if (!Cached)
+    {
+        return nullptr;
+    }
+
+    Cached->LastUsed = ++UseCounter;
+    return Cached->Cell;
+}
+
+bool FTerrainCellCache::Request(const FIntPoint& Coord, const int32 MaxInFlight)
+{
+    if (Cells.Contains(Coord) || Pending.Contains(Coord))
+    {
+        return true;
+    }
+    if (Pending.Num() >= MaxInFlight)
+    {
+        return false;
+    }
+
+    const TSharedRef<FPendingCell> PendingCell = MakeShared<FPendingCell>();
+    PendingCell->Task = UE::Tasks::Launch(TEXT("AutoWorldGen.TerrainCell"), [PendingCell, Generator = Generator, Settings = Settings, Coord]()
+    {
+        PendingCell->Cell = BuildCell(*Generator, Settings, Coord);
+    }, UE::Tasks::ETaskPriority::BackgroundNormal);
+
+    Pending.Add(Coord, PendingCell);
+    return true;
+}
+
+void FTerrainCellCache::CollectFinished()
+{
+    for (auto It = Pending.CreateIterator(); It; ++It)
+    {
+        if (!It->Value->Task.IsCompleted())
+        {
+            continue;
+        }
+
+        FCachedCell& Cached = Cells.Add(It->Key);
+        Cached.Cell = MoveTemp(It->Value->Cell);
+        Cached.LastUsed = ++UseCounter;
+        It.RemoveCurrent();
+    }
+}
+
+void FTerrainCellCache::WaitForPending() const
+{
+    for (const TPair<FIntPoint, TSharedRef<FPendingCell>>& Pair : Pending)
+    {
+        Pair.Value->Task.Wait();
+    }
+}
+
+void FTerrainCellCache::Trim(const int32 MaxCells)
+{
+    const int32 NumToEvict = Cells.Num() - FMath::Max(MaxCells, 0);
+    if (NumToEvict <= 0)
+    {
+        return;
+    }
+
+    TArray<TPair<uint64, FIntPoint>> ByLastUse;
+    ByLastUse.Reserve(Cells.Num());
+    for (const TPair<FIntPoint, FCachedCell>& Pair : Cells)
+    {
+        ByLastUse.Emplace(Pair.Value.LastUsed, Pair.Key);
+    }
+    ByLastUse.Sort([](const TPair<uint64, FIntPoint>& A, const TPair<uint64, FIntPoint>& B)
+    {
+        return A.Key < B.Key;
+    });
+
+    for (int32 i = 0; i < NumToEvict; i++)
+    {
+        Cells.Remove(ByLastUse[i].Value);
+    }
+}
+
+FIntPoint FTerrainCellCache::GetCellAt(const FVector& Location) const
+{
+    // Sample 0 of the world sits half the world size away from the origin, as on the generated landscape
+    const int32 Center = (Settings.WorldSize - 1) / 2;
+    const double SampleX = Location.X / Settings.TileSize + Center;
+    const double SampleY = Location.Y / Settings.TileSize + Center;
+    return FIntPoint(FMath::FloorToInt32(SampleX / Settings.CellQuads), FMath::FloorToInt32(SampleY / Settings.CellQuads));
+}
+
+FIntRect FTerrainCellCache::GetCellRegion(const FIntPoint& Coord, const int32 CellQuads)
+{
+    const FIntPoint Min(Coord.X * CellQuads - 1, Coord.Y * CellQuads - 1);
+    return FIntRect(Min, Min + FIntPoint(CellQuads + 3, CellQuads + 3));
+}
+
+TSharedRef<FTerrainCell> FTerrainCellCache::BuildCell(const FTerrainGenerator& Generator, const FTerrainCellSettings& Settings, const FIntPoint& Coord)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::TerrainCell);
+
+    const int32 CellQuads = Settings.CellQuads;
+    const FIntRect Region = GetCellRegion(Coord, CellQuads);
+    const FTerrainGenerator::FMatrix Heights = Generator.Generate(Region);
+
+    const TSharedRef<FTerrainCell> Cell = MakeShared<FTerrainCell>();
+    Cell->Coord = Coord;
+
+    const int32 NumVertsX = CellQuads + 1;
+    Cell->Vertices.SetNumUninitialized(NumVertsX * NumVertsX);
+    Cell->Normals.SetNumUninitialized(NumVertsX * NumVertsX);
+    Cell->UVs.SetNumUninitialized(NumVertsX * NumVertsX);
+    if (Heights.IsEmpty())
+    {
+        return Cell;
+    }
+
+    const double TileSize = Settings.TileSize;
+    const int32 Center = (Settings.WorldSize - 1) / 2;
+    for (int32 y = 0; y < NumVertsX; y++)
+    {
+        // Row y of the cell is row y + 1 of the heights, past the border
+        const VScalar* Row = Heights.GetRowData(y + 1);
+        const VScalar* RowAbove = Heights.GetRowData(y);
+        const VScalar* RowBelow = Heights.GetRowData(y + 2);
+        const int32 SampleY = Region.Min.Y + y + 1;
+
+        for (int32 x = 0; x < NumVertsX; x++)
+        {
+            const int32 Index = y * NumVertsX + x;
+            const int32 SampleX = Region.Min.X + x + 1;
+
+            // Heights are scaled by the tile size like the landscape, so the slopes are the height differences
+            const double Height = Row[x + 1];
+            const double SlopeX = (Row[x + 2] - Row[x]) * 0.5;
+            const double SlopeY = (RowBelow[x + 1] - RowAbove[x + 1]) * 0.5;
+
+            Cell->Vertices[Index] = FVector((SampleX - Center) * TileSize, (SampleY - Center) * TileSize, (Height - Settings.HeightOffset) * TileSize);
+            Cell->Normals[Index] = FVector(-SlopeX, -SlopeY, 1.0).GetSafeNormal();
+            Cell->UVs[Index] = FVector2D(SampleX, SampleY);
+        }
+    }
+
+    return Cell;
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTerrainCellCacheTest, "AutoWorldGen.TerrainCellCache.DeterministicSeamless", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTerrainCellCacheTest::RunTest(const FString& Parameters)
+{
+    FTerrainCellSettings Settings;
+    Settings.WorldSize = 512;
+    Settings.CellQuads = 63;
+    Settings.Biomes.Add(FBiome());
+    Settings.Biomes[0].k = Settings.WorldSize / 4.0;
+
+    // Cells on both sides of the corner of the world, so some lie outside of it
+    TArray<FIntPoint> Coords;
+    for (int32 y = -2; y <= 1; y++)
+    {
+        for (int32 x = -2; x <= 1; x++)
+        {
+            Coords.Add(FIntPoint(x, y));
+        }
+    }
+
+    FTerrainCellCache Cache(Settings);
+    auto BuildAll = [&Cache, &Coords]()
+    {
+        for (const FIntPoint& Coord : Coords)
+        {
+            Cache.Request(Coord, Coords.Num());
+        }
+        Cache.WaitForPending();
+        Cache.CollectFinished();
+    };
+
+    BuildAll();
+    TArray<TSharedPtr<const FTerrainCell>> First;
+    for (const FIntPoint& Coord : Coords)
+    {
+        First.Add(Cache.Find(Coord));
+        TestTrue(TEXT("Every requested cell is built"), First.Last().IsValid());
+    }
+    if (!TestEqual(TEXT("Every requested cell is cached"), Cache.Num(), Coords.Num()))
+    {
+        return false;
+    }
+
+    // Evicting everything and building again has to give the same cells
+    Cache.Trim(4);
+    TestEqual(TEXT("Trim keeps the most recently used cells"), Cache.Num(), 4);
+    Cache.Trim(0);
+    TestEqual(TEXT("Trim to 0 evicts every cell"), Cache.Num(), 0);
+    BuildAll();
+
+    const int32 NumVertsX = Settings.CellQuads + 1;
+    for (int32 i = 0; i < Coords.Num(); i++)
+    {
+        const TSharedPtr<const FTerrainCell> Cell = Cache.Find(Coords[i]);
+        TestTrue(TEXT("A rebuilt cell matches the evicted one"), Cell->Vertices == First[i]->Vertices && Cell->Normals == First[i]->Normals);
+
+        // The last column of a cell is the first column of its right neighbour, the last row the first row of the one below
+        const TSharedPtr<const FTerrainCell> Right = Cache.Find(Coords[i] + FIntPoint(1, 0));
+        const TSharedPtr<const FTerrainCell> Below = Cache.Find(Coords[i] + FIntPoint(0, 1));
+        bool bRightSeamless = true;
+        bool bBelowSeamless = true;
+        for (int32 j = 0; j < NumVertsX; j++)
+        {
+            if (Right.IsValid())
+            {
+                const int32 Edge = j * NumVertsX + Settings.CellQuads;
+                const int32 RightEdge = j * NumVertsX;
+                bRightSeamless &= Cell->Vertices[Edge] == Right->Vertices[RightEdge] && Cell->Normals[Edge] == Right->Normals[RightEdge];
+            }
+            if (Below.IsValid())
+            {
+                const int32 Edge = Settings.CellQuads * NumVertsX + j;
+                bBelowSeamless &= Cell->Vertices[Edge] == Below->Vertices[j] && Cell->Normals[Edge] == Below->Normals[j];
+            }
+        }
+        TestTrue(TEXT("A cell shares its right edge with its neighbour"), bRightSeamless);
+        TestTrue(TEXT("A cell shares its bottom edge with its neighbour"), bBelowSeamless);
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TerrainGenerator.h"
+#include "Tasks/Task.h"
+
+struct FTerrainCellSettings
+{
+	TArray<FBiome> Biomes;
+	// Biome origins are relative to the center of this many samples, the cells are not limited to it
+	int32 WorldSize = 512;
+	double WeightEpsilon = 0.0;
+	// Quads along each side of a cell, neighbouring cells share their edge samples
+	int32 CellQuads = 63;
+	// World units between samples, heights are scaled by it as on the generated landscape
+	double TileSize = 128.0;
+	// Generated height that lands on Z = 0
+	double HeightOffset = 256.0;
+};
+
+// Geometry of one cell in world space, vertices row by row
+struct FTerrainCell
+{
+	FIntPoint Coord;
+	TArray<FVector> Vertices;
+	TArray<FVector> Normals;
+	TArray<FVector2D> UVs;
+};
+
+/**
+ * Builds terrain cells on worker threads and keeps the most recently used ones.
+ * Cells only depend on their global coordinates, so an evicted cell is rebuilt exactly as it was.
+ */
+class AUTOWORLDGEN_API FTerrainCellCache
+{
+public:
+	explicit FTerrainCellCache(const FTerrainCellSettings& InSettings);
+
+	// Waits for the cells in flight
+	~FTerrainCellCache();
+
+	// The cell if it is built, which marks it as used
+	TSharedPtr<const FTerrainCell> Find(const FIntPoint& Coord);
+
+	// Starts building Coord unless it is built or in flight. False when MaxInFlight cells are in flight already.
+	bool Request(const FIntPoint& Coord, const int32 MaxInFlight);
+
+	// Moves the cells whose tasks are done into the cache
+	void CollectFinished();
+
+	void WaitForPending() const;
+
+	// Drops the least recently used cells until at most MaxCells are left
+	void Trim(const int32 MaxCells);
+
+	int32 Num() const { return Cells.Num(); }
+
+	int32 GetNumInFlight() const { return Pending.Num(); }
+
+	// Cell that covers a world location
+	FIntPoint GetCellAt(const FVector& Location) const;
+
+	// Same for every cell
+	const TArray<int32>& GetTriangles() const { return Triangles; }
+
+	const FTerrainCellSettings& GetSettings() const { return Settings; }
+
+	// Samples of the cell at Coord, with a border of one sample for the normals
+	static FIntRect GetCellRegion(const FIntPoint& Coord, const int32 CellQuads);
+
+	static TSharedRef<FTerrainCell> BuildCell(const FTerrainGenerator& Generator, const FTerrainCellSettings& Settings, const FIntPoint& Coord);
+
+private:
+	struct FCachedCell
+	{
+		TSharedPtr<const FTerrainCell> Cell;
+		uint64 LastUsed = 0;
+	};
+
+	struct FPendingCell
+	{
+		UE::Tasks::FTask Task;
+		TSharedPtr<FTerrainCell> Cell;
+	};
+
+	FTerrainCellSettings Settings;
+	// Shared with the tasks, each cell is generated on a single thread and the cells run in parallel
+	TSharedPtr<const FTerrainGenerator> Generator;
+	TArray<int32> Triangles;
+
+	TMap<FIntPoint, FCachedCell> Cells;
+	TMap<FIntPoint, TSharedRef<FPendingCell>> Pending;
+	uint64 UseCounter = 0;
+};
@@ -0,0 +1,430 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainErosion.h"
+#include "TerrainGenerator.h"
+
+#include "Async/ParallelFor.h"
+#include "Misc/AutomationTest.h"
+
+DECLARE_CYCLE_STAT(TEXT("Hydraulic Erosion"), STAT_AutoWorldGen_HydraulicErosion, STATGROUP_AutoWorldGen);
+DECLARE_CYCLE_STAT(TEXT("Thermal Erosion"), STAT_AutoWorldGen_ThermalErosion, STATGROUP_AutoWorldGen);
+
+namespace
+{
+    // Calls Sample(x, Left, Right) for every sample of a row. Samples on the border read themselves as the
+    // missing neighbour, which never has a drop to them, so the inner samples run without branches.
+    template<typename SampleType>
+    FORCEINLINE void ForEachSample(const int32 Width, SampleType&& Sample)
+    {
+        Sample(0, 0, FMath::Min(1, Width - 1));
+        for (int32 x = 1; x < Width - 1; ++x)
+        {
+            Sample(x, x - 1, x + 1);
+        }
+        if (Width > 1)
+        {
+            Sample(Width - 1, Width - 2, Width - 1);
+        }
+    }
+}
+
+template<typename ScalarType>
+TTerrainErosion<ScalarType>::TTerrainErosion(const FTerrainErosionSettings& InSettings, const int32 InNumThreads)
+    : Settings(InSettings)
+    , NumThreads(InNumThreads)
+{
+}
+
+template<typename ScalarType>
+void TTerrainErosion<ScalarType>::ParallelForBands(const int32 NumItems, TFunctionRef<void(int32, int32)> Body) const
+{
+    const int32 MaxBands = NumThreads > 0 ? NumThreads : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+    const int32 NumBands = FMath::Clamp(MaxBands, 1, FMath::Max(NumItems, 1));
+    const int32 ItemsPerBand = FMath::DivideAndRoundUp(NumItems, NumBands);
+
+    ParallelFor(NumBands, [&](const int32 Band)
+    {
+        const int32 Begin = Band * ItemsPerBand;
+        const int32 End = FMath::Min(Begin + ItemsPerBand, NumItems);
+        if (Begin < End)
+        {
+            Body(Begin, End);
+        }
+    }, NumBands == 1 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+}
+
+template<typename ScalarType>
+bool TTerrainErosion<ScalarType>::Erode(FMatrix& Heights) const
+{
+    if (Heights.IsEmpty() || !Settings.IsEnabled())
+    {
+        return true;
+    }
+
+    if (Progress)
+    {
+        const int64 NumSamples = static_cast<int64>(Heights.GetWidth()) * Heights.GetHeight();
+        Progress->Begin(NumSamples * (FMath::Max(Settings.HydraulicIterations, 0) + FMath::Max(Settings.ThermalIterations, 0)));
+    }
+
+    // Water carves the valleys first, the slopes it leaves too steep then settle
+    return ErodeHydraulic(Heights) && ErodeThermal(Heights);
+}
+
+template<typename ScalarType>
+bool TTerrainErosion<ScalarType>::ErodeHydraulic(FMatrix& Heights) const
+{
+    if (Settings.HydraulicIterations <= 0)
+    {
+        return true;
+    }
+
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::HydraulicErosion);
+    SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_HydraulicErosion);
+    FTerrainStageScope StageScope(Stats, ETerrainStage::Erosion);
+
+    const int32 Width = Heights.GetWidth();
+    const int32 Height = Heights.GetHeight();
+    const ScalarType RainAmount = static_cast<ScalarType>(Settings.RainAmount);
+    const ScalarType Retained = static_cast<ScalarType>(1.0 - Settings.EvaporationRate);
+    const ScalarType SedimentCapacity = static_cast<ScalarType>(Settings.SedimentCapacity);
+    const ScalarType ErosionRate = static_cast<ScalarType>(Settings.ErosionRate);
+    const ScalarType DepositionRate = static_cast<ScalarType>(Settings.DepositionRate);
+
+    FMatrix Water(Width, Height, RainAmount);
+    FMatrix Sediment(Width, Height, 0);
+    // Written by the first pass of an iteration and only read by the second:
+    // the water level, and the water and sediment sent per unit of drop to a lower neighbour
+    FMatrix Levels(Width, Height);
+    FMatrix OutflowScales(Width, Height);
+    FMatrix SedimentScales(Width, Height);
+    StageScope.AddAllocatedBytes(Water.GetAllocatedSize() * 5);
+
+    for (int32 Iteration = 0; Iteration < Settings.HydraulicIterations; ++Iteration)
+    {
+        if (Progress && Progress->IsCancelled())
+        {
+            return false;
+        }
+
+        // Each sample sends at most half of its largest drop, so it never ends up below the neighbour it drains into.
+        // The outflow is split over the lower neighbours by their drops.
+        ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+        {
+            for (int32 y = RowBegin; y < RowEnd; ++y)
+            {
+                const ScalarType* HeightRow = Heights.GetRowData(y);
+                const ScalarType* WaterRow = Water.GetRowData(y);
+                const ScalarType* SedimentRow = Sediment.GetRowData(y);
+                const ScalarType* HeightRowAbove = Heights.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* WaterRowAbove = Water.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* HeightRowBelow = Heights.GetRowData(FMath::Min(y + 1, Height - 1));
+                const ScalarType* WaterRowBelow = Water.GetRowData(FMath::Min(y + 1, Height - 1));
+                ScalarType* LevelRow = Levels.GetRowData(y);
+                ScalarType* OutflowScaleRow = OutflowScales.GetRowData(y);
+                ScalarType* SedimentScaleRow = SedimentScales.GetRowData(y);
+
+                ForEachSample(Width, [&](const int32 x, const int32 Left, const int32 Right)
+                {
+                    const ScalarType Level = HeightRow[x] + WaterRow[x];
+                    const ScalarType DropLeft = FMath::Max(Level - (HeightRow[Left] + WaterRow[Left]), static_cast<ScalarType>(0));
+                    const ScalarType DropRight = FMath::Max(Level - (HeightRow[Right] + WaterRow[Right]), static_cast<ScalarType>(0));
+                    const ScalarType DropAbove = FMath::Max(Level - (HeightRowAbove[x] + WaterRowAbove[x]), static_cast<ScalarType>(0));
+                    const ScalarType DropBelow = FMath::Max(Level - (HeightRowBelow[x] + WaterRowBelow[x]), static_cast<ScalarType>(0));
+                    const ScalarType TotalDrop = DropLeft + DropRight + DropAbove + DropBelow;
+                    const ScalarType MaxDrop = FMath::Max(FMath::Max(DropLeft, DropRight), FMath::Max(DropAbove, DropBelow));
+
+                    const ScalarType Outflow = FMath::Min(WaterRow[x], MaxDrop * static_cast<ScalarType>(0.5));
+                    const ScalarType OutflowScale = TotalDrop > 0 ? Outflow / TotalDrop : 0;
+                    LevelRow[x] = Level;
+                    OutflowScaleRow[x] = OutflowScale;
+                    SedimentScaleRow[x] = WaterRow[x] > 0 ? OutflowScale * SedimentRow[x] / WaterRow[x] : 0;
+                });
+            }
+        });
+
+        // Each sample gathers what its higher neighbours send it, then trades sediment with the ground
+        // depending on how much water flows through it
+        ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+        {
+            for (int32 y = RowBegin; y < RowEnd; ++y)
+            {
+                ScalarType* HeightRow = Heights.GetRowData(y);
+                ScalarType* WaterRow = Water.GetRowData(y);
+                ScalarType* SedimentRow = Sediment.GetRowData(y);
+                const ScalarType* LevelRow = Levels.GetRowData(y);
+                const ScalarType* LevelRowAbove = Levels.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* LevelRowBelow = Levels.GetRowData(FMath::Min(y + 1, Height - 1));
+                const ScalarType* OutflowScaleRow = OutflowScales.GetRowData(y);
+                const ScalarType* OutflowScaleRowAbove = OutflowScales.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* OutflowScaleRowBelow = OutflowScales.GetRowData(FMath::Min(y + 1, Height - 1));
+                const ScalarType* SedimentScaleRow = SedimentScales.GetRowData(y);
+                const ScalarType* SedimentScaleRowAbove = SedimentScales.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* SedimentScaleRowBelow = SedimentScales.GetRowData(FMath::Min(y + 1, Height - 1));
+
+                ForEachSample(Width, [&](const int32 x, const int32 Left, const int32 Right)
+                {
+                    // The neighbour computed the same drop with the opposite sign, so what it sends arrives in full
+                    const ScalarType Level = LevelRow[x];
+                    const ScalarType DropLeft = Level - LevelRow[Left];
+                    const ScalarType DropRight = Level - LevelRow[Right];
+                    const ScalarType DropAbove = Level - LevelRowAbove[x];
+                    const ScalarType DropBelow = Level - LevelRowBelow[x];
+                    const ScalarType TotalDrop = FMath::Max(DropLeft, static_cast<ScalarType>(0)) + FMath::Max(DropRight, static_cast<ScalarType>(0))
+                        + FMath::Max(DropAbove, static_cast<ScalarType>(0)) + FMath::Max(DropBelow, static_cast<ScalarType>(0));
+                    const ScalarType RiseLeft = FMath::Max(-DropLeft, static_cast<ScalarType>(0));
+                    const ScalarType RiseRight = FMath::Max(-DropRight, static_cast<ScalarType>(0));
+                    const ScalarType RiseAbove = FMath::Max(-DropAbove, static_cast<ScalarType>(0));
+                    const ScalarType RiseBelow = FMath::Max(-DropBelow, static_cast<ScalarType>(0));
+                    const ScalarType WaterIn = OutflowScaleRow[Left] * RiseLeft + OutflowScaleRow[Right] * RiseRight
+                        + OutflowScaleRowAbove[x] * RiseAbove + OutflowScaleRowBelow[x] * RiseBelow;
+                    const ScalarType SedimentIn = SedimentScaleRow[Left] * RiseLeft + SedimentScaleRow[Right] * RiseRight
+                        + SedimentScaleRowAbove[x] * RiseAbove + SedimentScaleRowBelow[x] * RiseBelow;
+
+                    const ScalarType Outflow = OutflowScaleRow[x] * TotalDrop;
+                    const ScalarType NewWater = FMath::Max(WaterRow[x] - Outflow + WaterIn, static_cast<ScalarType>(0));
+                    const ScalarType Sediment = FMath::Max(SedimentRow[x] - SedimentScaleRow[x] * TotalDrop + SedimentIn, static_cast<ScalarType>(0));
+
+                    // Fast water on steep ground picks up sediment, slow water drops it
+                    const ScalarType Capacity = SedimentCapacity * Outflow;
+                    const ScalarType Change = Sediment < Capacity
+                        ? ErosionRate * (Capacity - Sediment)
+                        : DepositionRate * (Capacity - Sediment);
+                    HeightRow[x] -= Change;
+                    SedimentRow[x] = Sediment + Change;
+                    WaterRow[x] = NewWater * Retained + RainAmount;
+                });
+            }
+        });
+
+        if (Progress)
+        {
+            Progress->Add(static_cast<int64>(Width) * Height, ETerrainStage::Erosion, INDEX_NONE);
+        }
+    }
+
+    // The sediment still in the water settles where it is
+    ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+    {
+        for (int32 y = RowBegin; y < RowEnd; ++y)
+        {
+            ScalarType* HeightRow = Heights.GetRowData(y);
+            const ScalarType* SedimentRow = Sediment.GetRowData(y);
+            for (int32 x = 0; x < Width; ++x)
+            {
+                HeightRow[x] += SedimentRow[x];
+            }
+        }
+    });
+
+    return true;
+}
+
+template<typename ScalarType>
+bool TTerrainErosion<ScalarType>::ErodeThermal(FMatrix& Heights) const
+{
+    if (Settings.ThermalIterations <= 0)
+    {
+        return true;
+    }
+
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::ThermalErosion);
+    SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_ThermalErosion);
+    FTerrainStageScope StageScope(Stats, ETerrainStage::Erosion);
+
+    const int32 Width = Heights.GetWidth();
+    const int32 Height = Heights.GetHeight();
+    const ScalarType TalusSlope = static_cast<ScalarType>(Settings.TalusSlope);
+    const ScalarType HalfRate = static_cast<ScalarType>(Settings.ThermalRate * 0.5);
+
+    // Material sent per unit of excess slope to a lower neighbour, and the heights of the next iteration
+    FMatrix MoveScales(Width, Height);
+    FMatrix NewHeights(Width, Height);
+    StageScope.AddAllocatedBytes(MoveScales.GetAllocatedSize() * 2);
+
+    for (int32 Iteration = 0; Iteration < Settings.ThermalIterations; ++Iteration)
+    {
+        if (Progress && Progress->IsCancelled())
+        {
+            return false;
+        }
+
+        // Each sample sends a share of its largest excess, split over the neighbours it is too steep above
+        ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+        {
+            for (int32 y = RowBegin; y < RowEnd; ++y)
+            {
+                const ScalarType* HeightRow = Heights.GetRowData(y);
+                const ScalarType* HeightRowAbove = Heights.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* HeightRowBelow = Heights.GetRowData(FMath::Min(y + 1, Height - 1));
+                ScalarType* MoveScaleRow = MoveScales.GetRowData(y);
+
+                ForEachSample(Width, [&](const int32 x, const int32 Left, const int32 Right)
+                {
+                    const ScalarType Limit = HeightRow[x] - TalusSlope;
+                    const ScalarType ExcessLeft = FMath::Max(Limit - HeightRow[Left], static_cast<ScalarType>(0));
+                    const ScalarType ExcessRight = FMath::Max(Limit - HeightRow[Right], static_cast<ScalarType>(0));
+                    const ScalarType ExcessAbove = FMath::Max(Limit - HeightRowAbove[x], static_cast<ScalarType>(0));
+                    const ScalarType ExcessBelow = FMath::Max(Limit - HeightRowBelow[x], static_cast<ScalarType>(0));
+                    const ScalarType TotalExcess = ExcessLeft + ExcessRight + ExcessAbove + ExcessBelow;
+                    const ScalarType MaxExcess = FMath::Max(FMath::Max(ExcessLeft, ExcessRight), FMath::Max(ExcessAbove, ExcessBelow));
+
+                    MoveScaleRow[x] = TotalExcess > 0 ? HalfRate * MaxExcess / TotalExcess : 0;
+                });
+            }
+        });
+
+        ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+        {
+            for (int32 y = RowBegin; y < RowEnd; ++y)
+            {
+                const ScalarType* HeightRow = Heights.GetRowData(y);
+                const ScalarType* HeightRowAbove = Heights.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* HeightRowBelow = Heights.GetRowData(FMath::Min(y + 1, Height - 1));
+                const ScalarType* MoveScaleRow = MoveScales.GetRowData(y);
+                const ScalarType* MoveScaleRowAbove = MoveScales.GetRowData(FMath::Max(y - 1, 0));
+                const ScalarType* MoveScaleRowBelow = MoveScales.GetRowData(FMath::Min(y + 1, Height - 1));
+                ScalarType* NewHeightRow = NewHeights.GetRowData(y);
+
+                ForEachSample(Width, [&](const int32 x, const int32 Left, const int32 Right)
+                {
+                    // The same excesses the senders computed, so nothing is lost on the way
+                    const ScalarType Limit = HeightRow[x] - TalusSlope;
+                    const ScalarType TotalExcess = FMath::Max(Limit - HeightRow[Left], static_cast<ScalarType>(0))
+                        + FMath::Max(Limit - HeightRow[Right], static_cast<ScalarType>(0))
+                        + FMath::Max(Limit - HeightRowAbove[x], static_cast<ScalarType>(0))
+                        + FMath::Max(Limit - HeightRowBelow[x], static_cast<ScalarType>(0));
+                    const ScalarType MovedIn = MoveScaleRow[Left] * FMath::Max(HeightRow[Left] - TalusSlope - HeightRow[x], static_cast<ScalarType>(0))
+                        + MoveScaleRow[Right] * FMath::Max(HeightRow[Right] - TalusSlope - HeightRow[x], static_cast<ScalarType>(0))
+                        + MoveScaleRowAbove[x] * FMath::Max(HeightRowAbove[x] - TalusSlope - HeightRow[x], static_cast<ScalarType>(0))
+                        + MoveScaleRowBelow[x] * FMath::Max(HeightRowBelow[x] - TalusSlope - HeightRow[x], static_cast<ScalarType>(0));
+
+                    NewHeightRow[x] = HeightRow[x] - MoveScaleRow[x] * TotalExcess + MovedIn;
+                });
+            }
+        });
+
+        Swap(Heights, NewHeights);
+
+        if (Progress)
+        {
+            Progress->Add(static_cast<int64>(Width) * Height, ETerrainStage::Erosion, INDEX_NONE);
+        }
+    }
+
+    return true;
+}
+
+template class TTerrainErosion<float>;
+template class TTerrainErosion<double>;
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+    double SumHeights(const FTerrainErosion::FMatrix& Heights, const bool bAbsolute = false)
+    {
+        double Sum = 0.0;
+        for (int32 y = 0; y < Heights.GetHeight(); ++y)
+        {
+            const VScalar* Row = Heights.GetRowData(y);
+            for (int32 x = 0; x < Heights.GetWidth(); ++x)
+            {
+                Sum += bAbsolute ? FMath::Abs(Row[x]) : Row[x];
+            }
+        }
+        return Sum;
+    }
+
+    // Largest height difference between neighbouring samples
+    double GetMaxSlope(const FTerrainErosion::FMatrix& Heights)
+    {
+        double MaxSlope = 0.0;
+        for (int32 y = 0; y < Heights.GetHeight(); ++y)
+        {
+            const VScalar* Row = Heights.GetRowData(y);
+            const VScalar* RowBelow = Heights.GetRowData(FMath::Min(y + 1, Heights.GetHeight() - 1));
+            for (int32 x = 0; x < Heights.GetWidth(); ++x)
+            {
+                MaxSlope = FMath::Max(MaxSlope, static_cast<double>(FMath::Abs(Row[FMath::Min(x + 1, Heights.GetWidth() - 1)] - Row[x])));
+                MaxSlope = FMath::Max(MaxSlope, static_cast<double>(FMath::Abs(RowBelow[x] - Row[x])));
+            }
+        }
+        return MaxSlope;
+    }
+
+    bool AreIdentical(const FTerrainErosion::FMatrix& A, const FTerrainErosion::FMatrix& B)
+    {
+        for (int32 y = 0; y < A.GetHeight(); ++y)
+        {
+            if (FMemory::Memcmp(A.GetRowData(y), B.GetRowData(y), A.GetWidth() * sizeof(VScalar)) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTerrainErosionTest, "AutoWorldGen.TerrainErosion.DeterministicConservative", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTerrainErosionTest::RunTest(const FString& Parameters)
+{
+    constexpr int32 WorldSize = 256;
+    constexpr int32 Iterations = 20;
+
+    TArray<FBiome> Biomes;
+    Biomes.SetNum(1);
+    Biomes[0].Octaves = 6;
+    Biomes[0].Range = FVector2D(-64.0, 256.0);
+    Biomes[0].NoiseScale = 0.02;
+    Biomes[0].k = WorldSize / 4.0;
+    const FTerrainErosion::FMatrix Heights = FTerrainGenerator(Biomes, WorldSize).Generate(FIntRect(0, 0, WorldSize, WorldSize));
+    const double SumBefore = SumHeights(Heights);
+    const double Tolerance = SumHeights(Heights, true) * 1.0e-5;
+    const double SlopeBefore = GetMaxSlope(Heights);
+
+    FTerrainErosionSettings Hydraulic;
+    Hydraulic.HydraulicIterations = Iterations;
+    FTerrainErosionSettings Thermal;
+    Thermal.ThermalIterations = Iterations;
+
+    for (const FTerrainErosionSettings& Settings : { Hydraulic, Thermal })
+    {
+        const FString Name = Settings.HydraulicIterations > 0 ? TEXT("Hydraulic") : TEXT("Thermal");
+
+        FTerrainErosion::FMatrix SingleThreaded = Heights;
+        TestTrue(*(Name + TEXT(" erosion on one thread completes")), FTerrainErosion(Settings, 1).Erode(SingleThreaded));
+
+        // Bands split the rows differently for every thread count
+        for (const int32 NumThreads : { 0, 3 })
+        {
+            FTerrainErosion::FMatrix Parallel = Heights;
+            FTerrainErosion(Settings, NumThreads).Erode(Parallel);
+            TestTrue(*FString::Printf(TEXT("%s erosion on %d threads gives the heights of one thread"), *Name, NumThreads), AreIdentical(SingleThreaded, Parallel));
+        }
+
+        // Material only moves between samples, the total only changes by rounding
+        const double SumChange = FMath::Abs(SumHeights(SingleThreaded) - SumBefore);
+        TestTrue(*FString::Printf(TEXT("%s erosion keeps the total height, changed by %g"), *Name, SumChange), SumChange <= Tolerance);
+        TestFalse(*(Name + TEXT(" erosion changes the heights")), AreIdentical(SingleThreaded, Heights));
+
+        if (Settings.ThermalIterations > 0)
+        {
+            TestTrue(TEXT("Thermal erosion flattens the steepest slope"), GetMaxSlope(SingleThreaded) < SlopeBefore);
+        }
+    }
+
+    // A cancelled erosion stops and reports it
+    FTerrainGenerationProgress Progress;
+    Progress.Cancel();
+    FTerrainErosion Cancelled(Hydraulic);
+    Cancelled.SetProgress(&Progress);
+    FTerrainErosion::FMatrix CancelledHeights = Heights;
+    TestFalse(TEXT("A cancelled erosion returns false"), Cancelled.Erode(CancelledHeights));
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Heightfield.h"
+#include "Hash/xxhash.h"
+#include "TerrainGenerationStats.h"
+#include "VaribleMatrix.h"
+
+#include "TerrainErosion.generated.h"
+
+using namespace VaribleMatrix;
+
+/**
+ * Erosion applied to the generated heights. Heights and distances are both in samples, so a slope of 1 is 45 degrees.
+ */
+USTRUCT(BlueprintType)
+struct AUTOWORLDGEN_API FTerrainErosionSettings
+{
+	GENERATED_BODY()
+
+public:
+	// Iterations of water flowing downhill, carrying sediment from steep to flat ground. 0 turns it off.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Hydraulic", meta = (ClampMin = "0"))
+	int32 HydraulicIterations = 0;
+
+	// Water added to every sample on each iteration
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Hydraulic", meta = (ClampMin = "0"))
+	double RainAmount = 0.01;
+
+	// Fraction of the water that evaporates on each iteration
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Hydraulic", meta = (ClampMin = "0", ClampMax = "1"))
+	double EvaporationRate = 0.02;
+
+	// Sediment a sample's outflow can carry per unit of water
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Hydraulic", meta = (ClampMin = "0"))
+	double SedimentCapacity = 1.0;
+
+	// Fraction of the free capacity taken from the ground on each iteration
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Hydraulic", meta = (ClampMin = "0", ClampMax = "1"))
+	double ErosionRate = 0.3;
+
+	// Fraction of the sediment above the capacity dropped on each iteration
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Hydraulic", meta = (ClampMin = "0", ClampMax = "1"))
+	double DepositionRate = 0.3;
+
+	// Iterations of material sliding down slopes steeper than TalusSlope. 0 turns it off.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Thermal", meta = (ClampMin = "0"))
+	int32 ThermalIterations = 0;
+
+	// Height difference to a neighbouring sample that stays stable
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Thermal", meta = (ClampMin = "0"))
+	double TalusSlope = 0.7;
+
+	// Fraction of the material above the talus slope moved on each iteration
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoWorldGen|Thermal", meta = (ClampMin = "0", ClampMax = "1"))
+	double ThermalRate = 0.5;
+
+	bool IsEnabled() const { return HydraulicIterations > 0 || ThermalIterations > 0; }
+
+	bool operator==(const FTerrainErosionSettings& Other) const
+	{
+		return HydraulicIterations == Other.HydraulicIterations
+			&& RainAmount == Other.RainAmount
+			&& EvaporationRate == Other.EvaporationRate
+			&& SedimentCapacity == Other.SedimentCapacity
+			&& ErosionRate == Other.ErosionRate
+			&& DepositionRate == Other.DepositionRate
+			&& ThermalIterations == Other.ThermalIterations
+			&& TalusSlope == Other.TalusSlope
+			&& ThermalRate == Other.ThermalRate;
+	}
+
+	bool operator!=(const FTerrainErosionSettings& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	// Every setting that changes the eroded heights
+	void AppendHash(FXxHash64Builder& Builder) const
+	{
+		Builder.Update(&HydraulicIterations, sizeof(HydraulicIterations));
+		Builder.Update(&RainAmount, sizeof(RainAmount));
+		Builder.Update(&EvaporationRate, sizeof(EvaporationRate));
+		Builder.Update(&SedimentCapacity, sizeof(SedimentCapacity));
+		Builder.Update(&ErosionRate, sizeof(ErosionRate));
+		Builder.Update(&DepositionRate, sizeof(DepositionRate));
+		Builder.Update(&ThermalIterations, sizeof(ThermalIterations));
+		Builder.Update(&TalusSlope, sizeof(TalusSlope));
+		Builder.Update(&ThermalRate, sizeof(ThermalRate));
+	}
+};
+
+/**
+ * Grid based hydraulic and thermal erosion of a whole heightfield.
+ * Every iteration runs as Jacobi passes: a sample's update only reads the previous pass, so the rows run in
+ * parallel bands and the result is the same for any number of threads. The hydraulic iterations run first.
+ * Material that would leave the heightfield stays at its border, the total height only changes by rounding.
+ */
+template<typename ScalarType>
+class TTerrainErosion
+{
+public:
+	typedef THeightfield<ScalarType> FMatrix;
+
+	explicit TTerrainErosion(const FTerrainErosionSettings& InSettings, const int32 InNumThreads = 0);
+
+	// Erodes Heights in place. False when the progress was cancelled, Heights are then only partly eroded.
+	bool Erode(FMatrix& Heights) const;
+
+	// Iterations run so far are added to Stats as the erosion stage
+	void SetStats(FTerrainGenerationStats* InStats) { Stats = InStats; }
+
+	// Erode starts the progress over for its iterations and stops between them once it is cancelled
+	void SetProgress(FTerrainGenerationProgress* InProgress) { Progress = InProgress; }
+
+	const FTerrainErosionSettings& GetSettings() const { return Settings; }
+
+private:
+	bool ErodeHydraulic(FMatrix& Heights) const;
+
+	bool ErodeThermal(FMatrix& Heights) const;
+
+	// Same split as the generator, contiguous bands of rows
+	void ParallelForBands(const int32 NumItems, TFunctionRef<void(int32, int32)> Body) const;
+
+	FTerrainErosionSettings Settings;
+	int32 NumThreads;
+	FTerrainGenerationStats* Stats = nullptr;
+	FTerrainGenerationProgress* Progress = nullptr;
+};
+
+extern template class TTerrainErosion<float>;
+extern template class TTerrainErosion<double>;
+
+typedef TTerrainErosion<VScalar> FTerrainErosion;
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainGenerationStats.h"
+
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+    // Stages are short compared to the lock, one for every stats object is plenty
+    FCriticalSection StatsLock;
+}
+
+void FTerrainGenerationStats::AddStage(const ETerrainStage Stage, const double Milliseconds, const int64 AllocatedBytes, const int32 BiomeIndex)
+{
+    FScopeLock Lock(&StatsLock);
+
+    FTerrainStageStats& StageStats = GetStage(Stage);
+    StageStats.Milliseconds += Milliseconds;
+    StageStats.AllocatedBytes += AllocatedBytes;
+
+    if (Stage == ETerrainStage::Noise && BiomeIndex != INDEX_NONE)
+    {
+        if (!BiomeNoise.IsValidIndex(BiomeIndex))
+        {
+            BiomeNoise.SetNum(BiomeIndex + 1);
+        }
+        BiomeNoise[BiomeIndex].Milliseconds += Milliseconds;
+        BiomeNoise[BiomeIndex].AllocatedBytes += AllocatedBytes;
+    }
+}
+
+void FTerrainGenerationStats::AddOctaveLayer(const bool bReused)
+{
+    FScopeLock Lock(&StatsLock);
+    (bReused ? OctaveLayersReused : OctaveLayersGenerated)++;
+}
+
+FTerrainStageStats& FTerrainGenerationStats::GetStage(const ETerrainStage Stage)
+{
+    switch (Stage)
+    {
+    case ETerrainStage::Noise:
+        return Noise;
+    case ETerrainStage::Blend:
+        return Blend;
+    case ETerrainStage::Erosion:
+        return Erosion;
+    case ETerrainStage::Quantize:
+        return Quantize;
+    case ETerrainStage::Import:
+        return Import;
+    default:
+        return PostEditChange;
+    }
+}
+
+FString FTerrainGenerationStats::ToString() const
+{
+    auto FormatStage = [](const TCHAR* Name, const FTerrainStageStats& Stage)
+    {
+        return FString::Printf(TEXT("%s %.1f ms / %.1f MB"), Name, Stage.Milliseconds, Stage.AllocatedBytes / (1024.0 * 1024.0));
+    };
+
+    FString Result = FString::Printf(TEXT("Terrain generation took %.1f ms: "), TotalMilliseconds);
+    Result += FormatStage(TEXT("Noise"), Noise) + TEXT(", ");
+    Result += FormatStage(TEXT("Blend"), Blend) + TEXT(", ");
+    if (Erosion.Milliseconds > 0.0)
+    {
+        Result += FormatStage(TEXT("Erosion"), Erosion) + TEXT(", ");
+    }
+    Result += FormatStage(TEXT("Quantize"), Quantize) + TEXT(", ");
+    Result += FormatStage(TEXT("Import"), Import) + TEXT(", ");
+    Result += FormatStage(TEXT("PostEditChange"), PostEditChange);
+    if (OctaveLayersReused + OctaveLayersGenerated > 0)
+    {
+        Result += FString::Printf(TEXT(", reused %d of %d octaves"), OctaveLayersReused, OctaveLayersReused + OctaveLayersGenerated);
+    }
+    return Result;
+}
+
+FTerrainStageScope::FTerrainStageScope(FTerrainGenerationStats* InStats, const ETerrainStage InStage, const int32 InBiomeIndex)
+    : Stats(InStats)
+    , Stage(InStage)
+    , BiomeIndex(InBiomeIndex)
+    , StartCycles(FPlatformTime::Cycles64())
+{
+}
+
+FTerrainStageScope::~FTerrainStageScope()
+{
+    if (Stats)
+    {
+        Stats->AddStage(Stage, FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles), AllocatedBytes, BiomeIndex);
+    }
+}
@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+#include <atomic>
+
+#include "TerrainGenerationStats.generated.h"
+
+DECLARE_STATS_GROUP(TEXT("AutoWorldGen"), STATGROUP_AutoWorldGen, STATCAT_Advanced);
+
+UENUM(BlueprintType)
+enum class ETerrainStage : uint8
+{
+	Noise,
+	Blend,
+	Erosion,
+	Quantize,
+	Import,
+	PostEditChange
+};
+
+USTRUCT(BlueprintType)
+struct FTerrainStageStats
+{
+	GENERATED_BODY()
+
+public:
+	// Summed over every task of the stage, so stages that run in parallel can add up to more than the wall time
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	double Milliseconds = 0.0;
+
+	// Heightfield memory the stage allocated
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	int64 AllocatedBytes = 0;
+};
+
+/**
+ * Where the time of the last generation went. Stages add to it from worker threads, so use AddStage.
+ */
+USTRUCT(BlueprintType)
+struct AUTOWORLDGEN_API FTerrainGenerationStats
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	FTerrainStageStats Noise;
+
+	// Noise of every biome, in the order of the biomes
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	TArray<FTerrainStageStats> BiomeNoise;
+
+	// Includes evaluating the biome falloffs
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	FTerrainStageStats Blend;
+
+	// Hydraulic and thermal iterations together
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	FTerrainStageStats Erosion;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	FTerrainStageStats Quantize;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	FTerrainStageStats Import;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	FTerrainStageStats PostEditChange;
+
+	// Wall time of the whole generation
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	double TotalMilliseconds = 0.0;
+
+	// Noise octaves taken from the octave cache and generated for it
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	int32 OctaveLayersReused = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "AutoWorldGen|Stats")
+	int32 OctaveLayersGenerated = 0;
+
+	// BiomeIndex only applies to the noise stage
+	void AddStage(const ETerrainStage Stage, const double Milliseconds, const int64 AllocatedBytes, const int32 BiomeIndex = INDEX_NONE);
+
+	FTerrainStageStats& GetStage(const ETerrainStage Stage);
+
+	void AddOctaveLayer(const bool bReused);
+
+	FString ToString() const;
+};
+
+/**
+ * Adds the time between construction and destruction to one stage of Stats, which may be null.
+ */
+class AUTOWORLDGEN_API FTerrainStageScope
+{
+public:
+	FTerrainStageScope(FTerrainGenerationStats* InStats, const ETerrainStage InStage, const int32 InBiomeIndex = INDEX_NONE);
+	~FTerrainStageScope();
+
+	void AddAllocatedBytes(const int64 Bytes) { AllocatedBytes += Bytes; }
+
+private:
+	FTerrainGenerationStats* Stats;
+	ETerrainStage Stage;
+	int32 BiomeIndex;
+	uint64 StartCycles;
+	int64 AllocatedBytes = 0;
+};
+
+/**
+ * Progress of a generation running on worker threads, and the flag that cancels it.
+ * Work is counted in samples: every octave of a biome's noise, every blend step and every erosion iteration add the samples they covered.
+ */
+class AUTOWORLDGEN_API FTerrainGenerationProgress
+{
+public:
+	void Begin(const int64 InTotalWork)
+	{
+		TotalWork = InTotalWork;
+		DoneWork = 0;
+	}
+
+	// Octave is INDEX_NONE for steps that are not a single octave
+	void Add(const int64 Work, const ETerrainStage Stage, const int32 Biome, const int32 Octave = INDEX_NONE)
+	{
+		DoneWork += Work;
+		LastStage = Stage;
+		LastBiome = Biome;
+		LastOctave = Octave;
+	}
+
+	double GetFraction() const
+	{
+		const int64 Total = TotalWork;
+		return Total > 0 ? FMath::Clamp(static_cast<double>(DoneWork) / Total, 0.0, 1.0) : 0.0;
+	}
+
+	// The step that finished last, biomes run concurrently so this is only meant for display
+	ETerrainStage GetLastStage() const { return LastStage; }
+	int32 GetLastBiome() const { return LastBiome; }
+	int32 GetLastOctave() const { return LastOctave; }
+
+	// The generator stops at the next row or octave and returns empty heights
+	void Cancel() { bCancelled = true; }
+	bool IsCancelled() const { return bCancelled; }
+
+private:
+	std::atomic<int64> TotalWork{ 0 };
+	std::atomic<int64> DoneWork{ 0 };
+	std::atomic<ETerrainStage> LastStage{ ETerrainStage::Noise };
+	std::atomic<int32> LastBiome{ INDEX_NONE };
+	std::atomic<int32> LastOctave{ INDEX_NONE };
+	std::atomic<bool> bCancelled{ false };
+};
@@ -0,0 +1,997 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainGenerator.h"
+#include "PerlinNoise.h"
+#include "TerrainTileSink.h"
+
+#include "Async/ParallelFor.h"
+#include "Tasks/Task.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/ScopeLock.h"
+
+DECLARE_CYCLE_STAT(TEXT("Biome Noise"), STAT_AutoWorldGen_Noise, STATGROUP_AutoWorldGen);
+DECLARE_CYCLE_STAT(TEXT("Noise Octave"), STAT_AutoWorldGen_NoiseOctave, STATGROUP_AutoWorldGen);
+DECLARE_CYCLE_STAT(TEXT("Blend"), STAT_AutoWorldGen_Blend, STATGROUP_AutoWorldGen);
+
+namespace
+{
+    // Noise layers only match when they were generated from the same noise over the same samples
+    uint64 GetNoiseLayerHash(const FBiome& Biome, const FIntRect& Support)
+    {
+        const uint64 NoiseHash = Biome.GetNoiseHash();
+
+        FXxHash64Builder Builder;
+        Builder.Update(&NoiseHash, sizeof(NoiseHash));
+        Builder.Update(&Support, sizeof(Support));
+        return Builder.Finalize().Hash;
+    }
+
+    int32 GetNumResampleTaps(const EHeightResampling Resampling)
+    {
+        return Resampling == EHeightResampling::Bicubic ? 4 : 2;
+    }
+
+    // Source samples and weights of the resampling filter at Position, samples past the edges repeat the edge
+    template<typename ScalarType>
+    void GetResampleTaps(const double Position, const int32 Num, const EHeightResampling Resampling, int32* OutIndices, ScalarType* OutWeights)
+    {
+        const int32 Index = FMath::Clamp(FMath::FloorToInt32(Position), 0, Num - 1);
+        const double T = FMath::Clamp(Position - Index, 0.0, 1.0);
+
+        if (Resampling == EHeightResampling::Bicubic)
+        {
+            // Catmull-Rom through the two samples on either side
+            const double Weights[4] =
+            {
+                ((-T + 2.0) * T - 1.0) * T * 0.5,
+                ((3.0 * T - 5.0) * T * T + 2.0) * 0.5,
+                ((-3.0 * T + 4.0) * T + 1.0) * T * 0.5,
+                (T - 1.0) * T * T * 0.5
+            };
+            for (int32 i = 0; i < 4; i++)
+            {
+                OutIndices[i] = FMath::Clamp(Index - 1 + i, 0, Num - 1);
+                OutWeights[i] = static_cast<ScalarType>(Weights[i]);
+            }
+            return;
+        }
+
+        OutIndices[0] = Index;
+        OutIndices[1] = FMath::Min(Index + 1, Num - 1);
+        OutWeights[0] = static_cast<ScalarType>(1.0 - T);
+        OutWeights[1] = static_cast<ScalarType>(T);
+    }
+}
+
+template<typename ScalarType>
+TTerrainGenerator<ScalarType>::TTerrainGenerator(const TArray<FBiome>& InBiomes, const int32 InWorldSize, const int32 InNumThreads)
+    : Biomes(InBiomes)
+    , WorldSize(InWorldSize)
+    , NumThreads(InNumThreads)
+{
+}
+
+template<typename ScalarType>
+int32 TTerrainGenerator<ScalarType>::GetNumBands(const int32 NumItems) const
+{
+    const int32 NumBands = NumThreads > 0 ? NumThreads : FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+    return FMath::Clamp(NumBands, 1, FMath::Max(NumItems, 1));
+}
+
+template<typename ScalarType>
+void TTerrainGenerator<ScalarType>::ParallelForBands(const int32 NumItems, TFunctionRef<void(int32, int32)> Body) const
+{
+    // Each band owns a contiguous range of items, the split only depends on NumItems and NumThreads
+    const int32 NumBands = GetNumBands(NumItems);
+    const int32 ItemsPerBand = FMath::DivideAndRoundUp(NumItems, NumBands);
+
+    ParallelFor(NumBands, [&](const int32 Band)
+    {
+        const int32 Begin = Band * ItemsPerBand;
+        const int32 End = FMath::Min(Begin + ItemsPerBand, NumItems);
+        if (Begin < End)
+        {
+            Body(Begin, End);
+        }
+    }, NumBands == 1 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+}
+
+template<typename ScalarType>
+FVector2D TTerrainGenerator<ScalarType>::GetBiomeCenter(const FBiome& Biome) const
+{
+    return FVector2D(Biome.Origin.X + WorldSize / 2, Biome.Origin.Y + WorldSize / 2) / SampleStride;
+}
+
+template<typename ScalarType>
+double TTerrainGenerator<ScalarType>::GetFalloffRadius(const FBiome& Biome, const double Epsilon)
+{
+    // 1 - Fade(d) = q / (1 + q) with q = a^(s - d / k), which decays only when ln(a) / k > 0
+    const double LogA = FMath::Loge(Biome.a);
+    if (Biome.a <= 0.0 || Biome.k == 0.0 || LogA / Biome.k <= 0.0)
+    {
+        return MAX_dbl;
+    }
+
+    const double Radius = (Biome.s * LogA + FMath::Loge((1.0 - Epsilon) / Epsilon)) * Biome.k / LogA;
+    return FMath::Max(Radius, 0.0);
+}
+
+template<typename ScalarType>
+FIntRect TTerrainGenerator<ScalarType>::GetChangedRegion(const TArray<FBiome>& PreviousBiomes, const FIntRect& Region, const FHeightQuantization& Quantization) const
+{
+    const int32 BiomeNum = Biomes.Num();
+    if (BiomeNum != PreviousBiomes.Num())
+    {
+        return Region;
+    }
+
+    // Below Epsilon a weight moves a height by less than 1/1024 of the 1/Scale quantization step, so only
+    // heights sitting right at a step can change outside of the region
+    double MaxAbsHeight = 1.0;
+    for (int32 i = 0; i < BiomeNum; i++)
+    {
+        MaxAbsHeight = FMath::Max3(MaxAbsHeight, FMath::Abs(Biomes[i].Range.X), FMath::Abs(Biomes[i].Range.Y));
+        MaxAbsHeight = FMath::Max3(MaxAbsHeight, FMath::Abs(PreviousBiomes[i].Range.X), FMath::Abs(PreviousBiomes[i].Range.Y));
+    }
+    const double Epsilon = 1.0 / (2048 * Quantization.Scale * MaxAbsHeight * BiomeNum);
+
+    FIntRect Changed;
+    bool bHasChanged = false;
+    auto AddBounds = [&](const FIntRect& Bounds)
+    {
+        if (Bounds.IsEmpty())
+        {
+            return;
+        }
+        if (bHasChanged)
+        {
+            Changed.Union(Bounds);
+        }
+        else
+        {
+            Changed = Bounds;
+            bHasChanged = true;
+        }
+    };
+    auto AddFalloff = [&](const FBiome& Biome)
+    {
+        AddBounds(GetFalloffBounds(Biome, Epsilon, Region));
+    };
+
+    // Same weights as in Generate: biome i is blended with W[i] - W[i - 1] and the last one with 1 - W[n - 2]
+    const int32 WeightNum = BiomeNum > 1 ? BiomeNum - 1 : BiomeNum;
+    for (int32 i = 0; i < BiomeNum; i++)
+    {
+        const FBiome& Biome = Biomes[i];
+        const FBiome& PreviousBiome = PreviousBiomes[i];
+
+        if (i < WeightNum && Biome.GetFalloffHash() != PreviousBiome.GetFalloffHash())
+        {
+            // W[i] only moves where either the old or the new weight is above Epsilon
+            AddFalloff(Biome);
+            AddFalloff(PreviousBiome);
+        }
+
+        if (Biome.GetNoiseHash() != PreviousBiome.GetNoiseHash())
+        {
+            if (i >= WeightNum)
+            {
+                // The last biome fills everything outside of the previous biome's falloff
+                return Region;
+            }
+
+            AddFalloff(Biome);
+            if (i > 0)
+            {
+                AddFalloff(Biomes[i - 1]);
+            }
+        }
+
+        // Noise is only blended inside the support, so samples entering or leaving it change as well
+        const FIntRect Support = GetBiomeSupport(Biomes, i, Region);
+        const FIntRect PreviousSupport = GetBiomeSupport(PreviousBiomes, i, Region);
+        if (Support != PreviousSupport)
+        {
+            AddBounds(Support);
+            AddBounds(PreviousSupport);
+        }
+    }
+
+    return bHasChanged ? Changed : FIntRect();
+}
+
+template<typename ScalarType>
+FIntRect TTerrainGenerator<ScalarType>::GetFalloffBounds(const FBiome& Biome, const double Epsilon, const FIntRect& Region) const
+{
+    const double Radius = GetFalloffRadius(Biome, Epsilon) / SampleStride;
+    const FVector2D Center = GetBiomeCenter(Biome);
+
+    // Clamp in double first, the radius can be far outside of the int32 range
+    return FIntRect(
+        FMath::FloorToInt32(FMath::Clamp(Center.X - Radius, static_cast<double>(Region.Min.X), static_cast<double>(Region.Max.X))),
+        FMath::FloorToInt32(FMath::Clamp(Center.Y - Radius, static_cast<double>(Region.Min.Y), static_cast<double>(Region.Max.Y))),
+        FMath::CeilToInt32(FMath::Clamp(Center.X + Radius + 1, static_cast<double>(Region.Min.X), static_cast<double>(Region.Max.X))),
+        FMath::CeilToInt32(FMath::Clamp(Center.Y + Radius + 1, static_cast<double>(Region.Min.Y), static_cast<double>(Region.Max.Y)))
+    );
+}
+
+template<typename ScalarType>
+FIntRect TTerrainGenerator<ScalarType>::GetBiomeSupport(const int32 Index, const FIntRect& Region) const
+{
+    return GetBiomeSupport(Biomes, Index, Region);
+}
+
+template<typename ScalarType>
+FIntRect TTerrainGenerator<ScalarType>::GetBiomeSupport(const TArray<FBiome>& InBiomes, const int32 Index, const FIntRect& Region) const
+{
+    const FBiome& Biome = InBiomes[Index];
+    const int32 BiomeNum = InBiomes.Num();
+
+    // The last biome of several fills everything outside of the previous falloff
+    if (WeightEpsilon <= 0.0 || (BiomeNum > 1 && Index == BiomeNum - 1))
+    {
+        return Region;
+    }
+
+    // Biome i is weighted with W[i] - W[i - 1], which stays below Epsilon where both falloffs do
+    FIntRect Support = GetFalloffBounds(Biome, WeightEpsilon, Region);
+    if (Index > 0)
+    {
+        const FIntRect PreviousBounds = GetFalloffBounds(InBiomes[Index - 1], WeightEpsilon, Region);
+        if (Support.IsEmpty())
+        {
+            Support = PreviousBounds;
+        }
+        else if (!PreviousBounds.IsEmpty())
+        {
+            Support.Union(PreviousBounds);
+        }
+    }
+
+    return Support;
+}
+
+template<typename ScalarType>
+void TTerrainGenerator<ScalarType>::QuantizeRow(const ScalarType* Heights, uint16* Out, const int32 Num, const FHeightQuantization& Quantization)
+{
+    for (int32 x = 0; x < Num; x++)
+    {
+        Out[x] = QuantizeHeight(Heights[x], Quantization);
+    }
+}
+
+template<typename ScalarType>
+void TTerrainGenerator<ScalarType>::Quantize(const FMatrix& Heights, const int32 Size, const EHeightResampling Resampling, const FHeightQuantization& Quantization, uint16* Out) const
+{
+    const int32 Width = Heights.GetWidth();
+    const int32 Height = Heights.GetHeight();
+    if (Size <= 0 || Width <= 0 || Height <= 0)
+    {
+        return;
+    }
+
+    if (Resampling == EHeightResampling::None || (Width == Size && Height == Size) || Size == 1)
+    {
+        check(Width >= Size && Height >= Size);
+        ParallelForBands(Size, [&](const int32 RowBegin, const int32 RowEnd)
+        {
+            for (int32 y = RowBegin; y < RowEnd; y++)
+            {
+                QuantizeRow(Heights.GetRowData(y), Out + static_cast<int64>(y) * Size, Size, Quantization);
+            }
+        });
+        return;
+    }
+
+    // The filter is separable: every output row first blends whole source rows, then the columns of that
+    // blended row. The column taps are the same for every row.
+    const int32 NumTaps = GetNumResampleTaps(Resampling);
+    const double StepX = static_cast<double>(Width - 1) / (Size - 1);
+    const double StepY = static_cast<double>(Height - 1) / (Size - 1);
+
+    TArray<int32> ColumnIndices;
+    TArray<ScalarType> ColumnWeights;
+    ColumnIndices.SetNumUninitialized(Size * NumTaps);
+    ColumnWeights.SetNumUninitialized(Size * NumTaps);
+    for (int32 x = 0; x < Size; x++)
+    {
+        GetResampleTaps(x * StepX, Width, Resampling, ColumnIndices.GetData() + x * NumTaps, ColumnWeights.GetData() + x * NumTaps);
+    }
+
+    ParallelForBands(Size, [&](const int32 RowBegin, const int32 RowEnd)
+    {
+        TArray<ScalarType> BlendedRow;
+        TArray<ScalarType> OutRow;
+        BlendedRow.SetNumUninitialized(Width);
+        OutRow.SetNumUninitialized(Size);
+
+        int32 RowIndices[4];
+        ScalarType RowWeights[4];
+        for (int32 y = RowBegin; y < RowEnd; y++)
+        {
+            GetResampleTaps(y * StepY, Height, Resampling, RowIndices, RowWeights);
+
+            const ScalarType* FirstRow = Heights.GetRowData(RowIndices[0]);
+            for (int32 x = 0; x < Width; x++)
+            {
+                BlendedRow[x] = FirstRow[x] * RowWeights[0];
+            }
+            for (int32 t = 1; t < NumTaps; t++)
+            {
+                const ScalarType* Row = Heights.GetRowData(RowIndices[t]);
+                const ScalarType Weight = RowWeights[t];
+                for (int32 x = 0; x < Width; x++)
+                {
+                    BlendedRow[x] += Row[x] * Weight;
+                }
+            }
+
+            for (int32 x = 0; x < Size; x++)
+            {
+                const int32* Indices = ColumnIndices.GetData() + x * NumTaps;
+                const ScalarType* Weights = ColumnWeights.GetData() + x * NumTaps;
+                ScalarType Value = 0;
+                for (int32 t = 0; t < NumTaps; t++)
+                {
+                    Value += BlendedRow[Indices[t]] * Weights[t];
+                }
+                OutRow[x] = Value;
+            }
+
+            QuantizeRow(OutRow.GetData(), Out + static_cast<int64>(y) * Size, Size, Quantization);
+        }
+    });
+}
+
+template<typename ScalarType>
+void TTerrainLayerCache<ScalarType>::Prepare(const FIntRect& Region, const int32 WorldSize)
+{
+    if (Region != CachedRegion || WorldSize != CachedWorldSize)
+    {
+        Reset();
+        CachedRegion = Region;
+        CachedWorldSize = WorldSize;
+    }
+}
+
+template<typename ScalarType>
+void TTerrainLayerCache<ScalarType>::Reset()
+{
+    CachedRegion = FIntRect();
+    CachedWorldSize = 0;
+    NoiseLayers.Empty();
+}
+
+template<typename ScalarType>
+void TTerrainLayerCache<ScalarType>::Store(TMap<uint64, TSharedPtr<const FMatrix>>&& InNoiseLayers)
+{
+    NoiseLayers = MoveTemp(InNoiseLayers);
+}
+
+template<typename ScalarType>
+TSharedPtr<const THeightfield<ScalarType>> TOctaveLayerCache<ScalarType>::Find(const FVector2D& Offset, const double Frequency, const FIntRect& Region, FIntPoint& OutOrigin)
+{
+    FScopeLock ScopeLock(&Lock);
+
+    for (FLayer& Layer : Layers)
+    {
+        if (Layer.Offset == Offset && Layer.Frequency == Frequency
+            && Layer.Region.Min.X <= Region.Min.X && Layer.Region.Min.Y <= Region.Min.Y
+            && Layer.Region.Max.X >= Region.Max.X && Layer.Region.Max.Y >= Region.Max.Y)
+        {
+            Layer.LastUsed = ++UseCounter;
+            Stats.Hits++;
+            OutOrigin = Region.Min - Layer.Region.Min;
+            return Layer.Samples;
+        }
+    }
+
+    Stats.Misses++;
+    return nullptr;
+}
+
+template<typename ScalarType>
+void TOctaveLayerCache<ScalarType>::Store(const FVector2D& Offset, const double Frequency, const FIntRect& Region, const TSharedPtr<const FMatrix>& Layer)
+{
+    if (!Layer.IsValid() || Layer->GetAllocatedSize() > MemoryBudget)
+    {
+        return;
+    }
+
+    FScopeLock ScopeLock(&Lock);
+
+    // Biomes that missed the same octave at the same time generate it twice, one copy is enough
+    for (const FLayer& Existing : Layers)
+    {
+        if (Existing.Offset == Offset && Existing.Frequency == Frequency && Existing.Region == Region)
+        {
+            return;
+        }
+    }
+
+    FLayer& NewLayer = Layers.AddDefaulted_GetRef();
+    NewLayer.Offset = Offset;
+    NewLayer.Frequency = Frequency;
+    NewLayer.Region = Region;
+    NewLayer.Samples = Layer;
+    NewLayer.LastUsed = ++UseCounter;
+    Stats.AllocatedBytes += Layer->GetAllocatedSize();
+
+    Evict();
+}
+
+template<typename ScalarType>
+bool TOctaveLayerCache<ScalarType>::ShouldCache(const FIntRect& Region) const
+{
+    FScopeLock ScopeLock(&Lock);
+    return Region.Area() * static_cast<int64>(sizeof(ScalarType)) <= MemoryBudget / 4;
+}
+
+template<typename ScalarType>
+void TOctaveLayerCache<ScalarType>::SetMemoryBudget(const int64 InMemoryBudget)
+{
+    FScopeLock ScopeLock(&Lock);
+    MemoryBudget = InMemoryBudget;
+    Evict();
+}
+
+template<typename ScalarType>
+void TOctaveLayerCache<ScalarType>::Reset()
+{
+    FScopeLock ScopeLock(&Lock);
+    Layers.Empty();
+    Stats.AllocatedBytes = 0;
+}
+
+template<typename ScalarType>
+FOctaveLayerCacheStats TOctaveLayerCache<ScalarType>::GetStats() const
+{
+    FScopeLock ScopeLock(&Lock);
+    FOctaveLayerCacheStats Result = Stats;
+    Result.NumLayers = Layers.Num();
+    return Result;
+}
+
+template<typename ScalarType>
+void TOctaveLayerCache<ScalarType>::Evict()
+{
+    while (Stats.AllocatedBytes > MemoryBudget && Layers.Num() > 0)
+    {
+        int32 Oldest = 0;
+        for (int32 i = 1; i < Layers.Num(); i++)
+        {
+            if (Layers[i].LastUsed < Layers[Oldest].LastUsed)
+            {
+                Oldest = i;
+            }
+        }
+
+        // Generations that still hold the layer keep it alive until they are done
+        Stats.AllocatedBytes -= Layers[Oldest].Samples->GetAllocatedSize();
+        Stats.Evictions++;
+        Layers.RemoveAtSwap(Oldest);
+    }
+}
+
+template<typename ScalarType>
+THeightfield<ScalarType> TTerrainGenerator<ScalarType>::Generate(const FIntRect& Region, TTerrainLayerCache<ScalarType>* Cache) const
+{
+    using namespace UE::Tasks;
+
+    const int32 BiomeNum = Biomes.Num();
+    if (BiomeNum == 0 || Region.IsEmpty())
+    {
+        return FMatrix();
+    }
+
+    if (Cache)
+    {
+        Cache->Prepare(Region, WorldSize);
+    }
+
+    // With a single thread every task runs inline as soon as its prerequisites are done
+    const EExtendedTaskPriority ExtendedPriority = NumThreads == 1 ? EExtendedTaskPriority::Inline : EExtendedTaskPriority::None;
+
+    // Noise is only generated where the biome's blend weight can reach the weight epsilon
+    TArray<FIntRect> Supports;
+    TArray<TSharedPtr<const FMatrix>> BiomeNoiseMaps;
+    TArray<FTask> NoiseTasks;
+    Supports.SetNum(BiomeNum);
+    BiomeNoiseMaps.SetNum(BiomeNum);
+    NoiseTasks.SetNum(BiomeNum);
+    int32 NumReused = 0;
+    int64 NumNoiseSamples = 0;
+    int64 TotalWork = 0;
+    for (int32 i = 0; i < BiomeNum; i++)
+    {
+        Supports[i] = GetBiomeSupport(i, Region);
+        NumNoiseSamples += static_cast<int64>(Supports[i].Width()) * Supports[i].Height();
+        TotalWork += static_cast<int64>(Supports[i].Width()) * Supports[i].Height() * (Biomes[i].Octaves + 1);
+    }
+    if (Progress)
+    {
+        Progress->Begin(TotalWork);
+    }
+
+    for (int32 i = 0; i < BiomeNum; i++)
+    {
+        BiomeNoiseMaps[i] = Cache ? Cache->FindNoise(GetNoiseLayerHash(Biomes[i], Supports[i])) : nullptr;
+        if (BiomeNoiseMaps[i].IsValid())
+        {
+            NumReused++;
+            if (Progress)
+            {
+                Progress->Add(static_cast<int64>(Supports[i].Width()) * Supports[i].Height() * Biomes[i].Octaves, ETerrainStage::Noise, i);
+            }
+            continue;
+        }
+        if (Supports[i].IsEmpty())
+        {
+            BiomeNoiseMaps[i] = MakeShared<const FMatrix>();
+            continue;
+        }
+
+        NoiseTasks[i] = Launch(TEXT("AutoWorldGen.BiomeNoise"), [this, &BiomeNoiseMaps, &Supports, i]()
+        {
+            FTerrainStageScope StageScope(Stats, ETerrainStage::Noise, i);
+            BiomeNoiseMaps[i] = MakeShared<const FMatrix>(GetNoiseMap(Biomes[i], Supports[i], i));
+            StageScope.AddAllocatedBytes(BiomeNoiseMaps[i]->GetAllocatedSize());
+        }, ETaskPriority::Normal, ExtendedPriority);
+    }
+
+    // Each blend step runs as soon as its biome is ready. The steps are chained so the
+    // biomes are always summed in the same order and the result does not depend on scheduling.
+    // Layers are released as soon as no later biome needs them, unless the cache keeps them.
+    const bool bReleaseLayers = Cache == nullptr;
+    FMatrix Heights;
+    FTask BlendTask;
+    for (int32 i = 0; i < BiomeNum; i++)
+    {
+        // Layers taken from the cache have no task to wait for
+        TArray<FTask, TInlineAllocator<4>> BlendPrerequisites;
+        auto AddPrerequisite = [&BlendPrerequisites](const FTask& Task)
+        {
+            if (Task.IsValid())
+            {
+                BlendPrerequisites.Add(Task);
+            }
+        };
+
+        AddPrerequisite(NoiseTasks[i]);
+        if (i > 0)
+        {
+            AddPrerequisite(BlendTask);
+        }
+
+        BlendTask = Launch(TEXT("AutoWorldGen.BiomeBlend"), [this, &Heights, &BiomeNoiseMaps, &Supports, &Region, bReleaseLayers, i]()
+        {
+            if (!Progress || !Progress->IsCancelled())
+            {
+                BlendBiome(Heights, i, Region, *BiomeNoiseMaps[i]);
+            }
+            if (Progress)
+            {
+                Progress->Add(static_cast<int64>(Supports[i].Width()) * Supports[i].Height(), ETerrainStage::Blend, i);
+            }
+
+            if (bReleaseLayers)
+            {
+                // No later biome references this noise map
+                BiomeNoiseMaps[i].Reset();
+            }
+        }, BlendPrerequisites, ETaskPriority::Normal, ExtendedPriority);
+    }
+
+    BlendTask.Wait();
+
+    if (Progress && Progress->IsCancelled())
+    {
+        // Layers of a cancelled run can be cut short, none of them go into the cache
+        return FMatrix();
+    }
+
+    UE_LOG(LogTemp, Verbose, TEXT("Biome noise covers %lld samples for %lld in the region."),
+        NumNoiseSamples, static_cast<int64>(Region.Width()) * Region.Height());
+
+    if (Cache)
+    {
+        // Only the layers of the current biomes are kept, stale ones are dropped
+        TMap<uint64, TSharedPtr<const FMatrix>> NoiseLayers;
+        for (int32 i = 0; i < BiomeNum; i++)
+        {
+            NoiseLayers.Add(GetNoiseLayerHash(Biomes[i], Supports[i]), BiomeNoiseMaps[i]);
+        }
+        Cache->Store(MoveTemp(NoiseLayers));
+
+        UE_LOG(LogTemp, Verbose, TEXT("Reused %d of %d biome layers."), NumReused, BiomeNum);
+    }
+
+    return Heights;
+}
+
+template<typename ScalarType>
+Expr::FRadialFalloff TTerrainGenerator<ScalarType>::GetFalloff(const FBiome& Biome, const FIntRect& Region) const
+{
+    // Falloffs are combined with matrices of Region, so the center is moved into its coordinates
+    return RadialFalloff(GetBiomeCenter(Biome) - FVector2D(Region.Min), Biome.a, Biome.s, Biome.k / SampleStride);
+}
+
+template<typename ScalarType>
+void TTerrainGenerator<ScalarType>::BlendBiome(FMatrix& Heights, const int32 Index, const FIntRect& Region, const FMatrix& NoiseMap) const
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::Blend);
+    SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_Blend);
+    FTerrainStageScope StageScope(Stats, ETerrainStage::Blend);
+
+    // Biome i is weighted with W[i] - W[i - 1] and the last one with 1 - W[n - 2],
+    // where W[i] is the falloff of biome i evaluated at every sample of the pass
+    const FIntRect Support = GetBiomeSupport(Index, Region);
+    if (Index == 0 && Support == Region)
+    {
+        Assign(Heights, Multiply(NoiseMap, GetFalloff(Biomes[0], Region)));
+        StageScope.AddAllocatedBytes(Heights.GetAllocatedSize());
+        return;
+    }
+    if (Index == 0)
+    {
+        // Everything outside of the supports stays at zero
+        Heights = FMatrix(Region.Width(), Region.Height(), 0);
+        StageScope.AddAllocatedBytes(Heights.GetAllocatedSize());
+    }
+    if (Support.IsEmpty())
+    {
+        return;
+    }
+
+    // Support in the coordinates of Heights
+    const FIntRect Rect(Support.Min - Region.Min, Support.Max - Region.Min);
+    if (Index == 0)
+    {
+        AddInPlace(Heights, Rect, Multiply(NoiseMap, GetFalloff(Biomes[0], Support)));
+    }
+    else if (Index == Biomes.Num() - 1)
+    {
+        AddInPlace(Heights, Rect, Multiply(NoiseMap, Subtract(1, GetFalloff(Biomes[Index - 1], Support))));
+    }
+    else
+    {
+        AddInPlace(Heights, Rect, Multiply(NoiseMap, Subtract(GetFalloff(Biomes[Index], Support), GetFalloff(Biomes[Index - 1], Support))));
+    }
+}
+
+template<typename ScalarType>
+int32 TTerrainGenerator<ScalarType>::GetStreamingBandRows(const int32 Width, const int64 MemoryBudget, const int32 RowAlignment) const
+{
+    // Upper bound of what is alive per row while a band is generated: every biome's noise map and the heights
+    const int64 BytesPerRow = static_cast<int64>(Width) * sizeof(ScalarType) * (Biomes.Num() + 1);
+
+    const int32 Alignment = FMath::Max(RowAlignment, 1);
+    const int64 Rows = MemoryBudget / FMath::Max<int64>(BytesPerRow, 1);
+    return FMath::Max<int32>(static_cast<int32>(FMath::Min<int64>(Rows, MAX_int32) / Alignment) * Alignment, Alignment);
+}
+
+template<typename ScalarType>
+bool TTerrainGenerator<ScalarType>::GenerateStreamed(const FIntPoint& Size, const int64 MemoryBudget, const int32 RowAlignment, TTerrainTileSink<ScalarType>& Sink) const
+{
+    const int32 BandRows = GetStreamingBandRows(Size.X, MemoryBudget, RowAlignment);
+
+    for (int32 Y = 0; Y < Size.Y; Y += BandRows)
+    {
+        const FIntRect Band(0, Y, Size.X, FMath::Min(Y + BandRows, Size.Y));
+        const FMatrix Heights = Generate(Band);
+        if (Progress && Progress->IsCancelled())
+        {
+            return false;
+        }
+
+        if (!Sink.WriteTile(Band, Heights))
+        {
+            UE_LOG(LogTemp, Error, TEXT("Failed to write terrain rows %d to %d."), Band.Min.Y, Band.Max.Y);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename ScalarType>
+TSharedPtr<const THeightfield<ScalarType>> TTerrainGenerator<ScalarType>::GetOctaveLayer(const FVector2D& Offset, const double Frequency, const FIntRect& Region, FIntPoint& OutOrigin) const
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::OctaveLayer);
+
+    TSharedPtr<const FMatrix> Layer = OctaveCache->Find(Offset, Frequency, Region, OutOrigin);
+    if (Stats)
+    {
+        Stats->AddOctaveLayer(Layer.IsValid());
+    }
+    if (Layer.IsValid())
+    {
+        return Layer;
+    }
+
+    const int32 Width = Region.Width();
+    const TSharedPtr<FMatrix> NewLayer = MakeShared<FMatrix>(Width, Region.Height());
+    ParallelForBands(Region.Height(), [&](const int32 RowBegin, const int32 RowEnd)
+    {
+        for (int32 y = RowBegin; y < RowEnd; ++y)
+        {
+            if (Progress && Progress->IsCancelled())
+            {
+                return;
+            }
+            PerlinNoise::SampleRow(NewLayer->GetRowData(y), Width, Region.Min.X, Region.Min.Y + y, Frequency, Offset);
+        }
+    });
+
+    // A layer cut short by a cancel is never stored
+    if (Progress && Progress->IsCancelled())
+    {
+        return nullptr;
+    }
+
+    OutOrigin = FIntPoint(0, 0);
+    OctaveCache->Store(Offset, Frequency, Region, NewLayer);
+    return NewLayer;
+}
+
+template<typename ScalarType>
+THeightfield<ScalarType> TTerrainGenerator<ScalarType>::GetNoiseMap(const FBiome& Biome, const FIntRect& Region, const int32 BiomeIndex) const
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::Noise);
+    TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(*Biome.Name);
+    SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_Noise);
+
+    const bool bGradientDetailReduction = Biome.bGradientDetailReduction;
+    const double GradientDetailReductionSpeed = Biome.GradientDetailReductionSpeed;
+    const uint8 Octaves = Biome.Octaves;
+    const double Persistence = Biome.Persistence;
+    const double Lacunarity = Biome.Lacunarity;
+    // Noise coordinates grow with the stride, so every sample sees the noise of its world sample
+    const double NoiseScale = Biome.NoiseScale;
+    int32 Seed = Biome.Seed;
+
+    const int32 Width = Region.Width();
+    const int32 Height = Region.Height();
+
+    FMatrix NoiseMap(Width, Height, 0);
+
+    double MaxNoiseHeight = 0.0f;
+    TArray<FVector2D> OctaveOffsets;
+    TArray<double> OctaveAmplitudes;
+    TArray<double> OctaveFrequencies;
+    OctaveOffsets.SetNum(Octaves);
+    OctaveAmplitudes.SetNum(Octaves);
+    OctaveFrequencies.SetNum(Octaves);
+
+    double Amplitude = 1.0f;
+    double FrequencyAcc = 1.0f;
+    for (uint8 o = 0; o < Octaves; ++o)
+    {
+        MaxNoiseHeight += FMath::Pow(Persistence, o);
+
+        FRandomStream RandomStream(Seed++);
+        double OffsetX = RandomStream.FRandRange(-100000.0f, 100000.0f);
+        double OffsetY = RandomStream.FRandRange(-100000.0f, 100000.0f);
+        OctaveOffsets[o] = FVector2D(OffsetX, OffsetY);
+
+        OctaveAmplitudes[o] = Amplitude;
+        OctaveFrequencies[o] = FrequencyAcc;
+        Amplitude *= Persistence;
+        FrequencyAcc *= Lacunarity;
+    }
+
+    if (!bGradientDetailReduction && OctaveCache && OctaveCache->ShouldCache(Region))
+    {
+        // Cached octaves are kept whole, so they are added from their layers instead of per row.
+        // Each layer is let go of before the next one is fetched, only the cache holds on to it.
+        for (uint8 o = 0; o < Octaves; ++o)
+        {
+            TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::NoiseOctave);
+            SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_NoiseOctave);
+
+            FIntPoint OctaveOrigin;
+            const TSharedPtr<const FMatrix> OctaveLayer = GetOctaveLayer(OctaveOffsets[o], OctaveFrequencies[o] * NoiseScale * SampleStride, Region, OctaveOrigin);
+            if (!OctaveLayer.IsValid())
+            {
+                return NoiseMap;
+            }
+
+            // Same order and precision as accumulating the rows
+            const ScalarType OctaveAmplitude = static_cast<ScalarType>(OctaveAmplitudes[o]);
+            ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+            {
+                for (int32 y = RowBegin; y < RowEnd; ++y)
+                {
+                    ScalarType* NoiseRow = NoiseMap.GetRowData(y);
+                    const ScalarType* OctaveRow = OctaveLayer->GetRowData(OctaveOrigin.Y + y) + OctaveOrigin.X;
+                    for (int32 x = 0; x < Width; ++x)
+                    {
+                        NoiseRow[x] += OctaveRow[x] * OctaveAmplitude;
+                    }
+                }
+            });
+
+            if (Progress)
+            {
+                Progress->Add(static_cast<int64>(Width) * Height, ETerrainStage::Noise, BiomeIndex, o);
+            }
+        }
+    }
+    else if (!bGradientDetailReduction)
+    {
+        // Every point is independent, so each band runs all octaves over its own rows
+        ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+        {
+            for (int32 y = RowBegin; y < RowEnd; ++y)
+            {
+                if (Progress && Progress->IsCancelled())
+                {
+                    return;
+                }
+
+                ScalarType* NoiseRow = NoiseMap.GetRowData(y);
+                for (uint8 o = 0; o < Octaves; ++o)
+                {
+                    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::NoiseOctave);
+                    SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_NoiseOctave);
+
+                    PerlinNoise::AccumulateRow(NoiseRow, Width, Region.Min.X, Region.Min.Y + y, OctaveFrequencies[o] * NoiseScale * SampleStride, OctaveOffsets[o], OctaveAmplitudes[o]);
+                }
+
+                // Rows run every octave at once, so they are reported without one
+                if (Progress)
+                {
+                    Progress->Add(static_cast<int64>(Width) * Octaves, ETerrainStage::Noise, BiomeIndex);
+                }
+            }
+        });
+    }
+    else
+    {
+        // Gradient detail reduction follows the analytic gradient of the octaves summed so far, so
+        // every sample only depends on its own coordinates and the rows run in parallel
+        // The derivatives are per sample, the speed applies to the gradient in noise coordinates
+        // so it does not depend on the noise scale or the sample stride
+        const ScalarType ReductionSpeed = static_cast<ScalarType>(GradientDetailReductionSpeed / (NoiseScale * SampleStride));
+        const ScalarType DetailLacunarity = static_cast<ScalarType>(Lacunarity);
+
+        ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+        {
+            TArray<ScalarType> OctaveRow;
+            TArray<ScalarType> OctaveDx;
+            TArray<ScalarType> OctaveDy;
+            TArray<ScalarType> GradientX;
+            TArray<ScalarType> GradientY;
+            TArray<ScalarType> DetailRow;
+            OctaveRow.SetNumUninitialized(Width);
+            OctaveDx.SetNumUninitialized(Width);
+            OctaveDy.SetNumUninitialized(Width);
+            GradientX.SetNumUninitialized(Width);
+            GradientY.SetNumUninitialized(Width);
+            DetailRow.SetNumUninitialized(Width);
+
+            for (int32 y = RowBegin; y < RowEnd; ++y)
+            {
+                if (Progress && Progress->IsCancelled())
+                {
+                    return;
+                }
+
+                for (int32 x = 0; x < Width; ++x)
+                {
+                    GradientX[x] = 0;
+                    GradientY[x] = 0;
+                    DetailRow[x] = 1;
+                }
+
+                ScalarType* NoiseRow = NoiseMap.GetRowData(y);
+                for (uint8 o = 0; o < Octaves; ++o)
+                {
+                    TRACE_CPUPROFILER_EVENT_SCOPE(AutoWorldGen::NoiseOctave);
+                    SCOPE_CYCLE_COUNTER(STAT_AutoWorldGen_NoiseOctave);
+
+                    PerlinNoise::SampleRowWithDerivatives(OctaveRow.GetData(), OctaveDx.GetData(), OctaveDy.GetData(), Width, Region.Min.X, Region.Min.Y + y, OctaveFrequencies[o] * NoiseScale * SampleStride, OctaveOffsets[o], OctaveAmplitudes[o]);
+
+                    // Reduce higher details based on the gradient of the reduced octaves so far
+                    for (int32 x = 0; x < Width; ++x)
+                    {
+                        const ScalarType DetailFactor = DetailRow[x];
+                        GradientX[x] += OctaveDx[x] * DetailFactor;
+                        GradientY[x] += OctaveDy[x] * DetailFactor;
+                        NoiseRow[x] += OctaveRow[x] * DetailFactor;
+
+                        const ScalarType GradLen = FMath::Sqrt(GradientX[x] * GradientX[x] + GradientY[x] * GradientY[x]);
+                        const ScalarType NewDetailFactor = 1 / (1 + ReductionSpeed * GradLen);
+                        DetailRow[x] = DetailFactor * (1 - DetailLacunarity) + NewDetailFactor * DetailLacunarity;
+                    }
+                }
+
+                if (Progress)
+                {
+                    Progress->Add(static_cast<int64>(Width) * Octaves, ETerrainStage::Noise, BiomeIndex);
+                }
+            }
+        });
+    }
+
+    // Normalize the noise value to the specified range
+    ParallelForBands(Height, [&](const int32 RowBegin, const int32 RowEnd)
+    {
+        for (int32 y = RowBegin; y < RowEnd; ++y)
+        {
+            ScalarType* NoiseRow = NoiseMap.GetRowData(y);
+            for (int32 x = 0; x < Width; ++x)
+            {
+                const double NoiseHeight = NoiseRow[x];
+
+                const double NormalizedHeight = FMath::GetMappedRangeValueClamped(
+                    FVector2D(-1.0f, 1.0f),
+                    Biome.Range,
+                    NoiseHeight / MaxNoiseHeight
+                );
+
+                NoiseRow[x] = static_cast<ScalarType>(NormalizedHeight);
+            }
+        }
+    });
+
+    return NoiseMap;
+}
+
+template class TTerrainLayerCache<float>;
+template class TTerrainLayerCache<double>;
+template class TOctaveLayerCache<float>;
+template class TOctaveLayerCache<double>;
+template class TTerrainGenerator<float>;
+template class TTerrainGenerator<double>;
+
+int32 MeasurePrecisionError(const TArray<FBiome>& Biomes, const int32 WorldSize, const int32 NumThreads)
+{
+    const FIntRect Region(0, 0, WorldSize, WorldSize);
+    const THeightfield<float> FloatHeights = TTerrainGenerator<float>(Biomes, WorldSize, NumThreads).Generate(Region);
+    const THeightfield<double> DoubleHeights = TTerrainGenerator<double>(Biomes, WorldSize, NumThreads).Generate(Region);
+
+    int32 MaxError = 0;
+    for (int32 y = 0; y < Region.Height(); ++y)
+    {
+        const float* FloatRow = FloatHeights.GetRowData(y);
+        const double* DoubleRow = DoubleHeights.GetRowData(y);
+        for (int32 x = 0; x < Region.Width(); ++x)
+        {
+            const int32 Error = FMath::Abs(TTerrainGenerator<float>::QuantizeHeight(FloatRow[x]) - TTerrainGenerator<double>::QuantizeHeight(DoubleRow[x]));
+            MaxError = FMath::Max(MaxError, Error);
+        }
+    }
+
+    return MaxError;
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTerrainPrecisionTest, "AutoWorldGen.TerrainGenerator.FloatMatchesDouble", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FTerrainPrecisionTest::RunTest(const FString& Parameters)
+{
+    constexpr int32 WorldSize = 1024;
+
+    // One biome of each noise kind, blended into each other
+    TArray<FBiome> Biomes;
+    Biomes.SetNum(3);
+    Biomes[0].Octaves = 6;
+    Biomes[0].Range = FVector2D(-64.0, 256.0);
+    Biomes[0].k = WorldSize / 16.0;
+    Biomes[1].bGradientDetailReduction = true;
+    Biomes[1].Octaves = 4;
+    Biomes[1].Seed = 1;
+    Biomes[1].Origin = FVector2D(WorldSize / 4.0, 0.0);
+    Biomes[1].k = WorldSize / 16.0;
+    Biomes[2].Seed = 2;
+
+    // The float pipeline may round a landscape height to the neighbouring step, never further
+    const int32 MaxError = MeasurePrecisionError(Biomes, WorldSize);
+    TestTrue(*FString::Printf(TEXT("Largest height difference %d between float and double generation is at most 1"), MaxError), MaxError <= 1);
+    return true;
+}
+
+#endif
@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VaribleMatrix.h"
+#include "Biome.h"
+#include "TerrainGenerationStats.h"
+#include "HeightQuantization.h"
+#include "HAL/CriticalSection.h"
+
+using namespace VaribleMatrix;
+
+template<typename ScalarType> class TTerrainTileSink;
+
+/**
+ * Noise layers of previous generations, keyed by the content hash of the biome parameters and the
+ * samples they were built for, so only biomes that changed are generated again.
+ */
+template<typename ScalarType>
+class TTerrainLayerCache
+{
+public:
+	typedef THeightfield<ScalarType> FMatrix;
+
+	// Drops every layer when the region or world size differs from the one the layers were built for
+	void Prepare(const FIntRect& Region, const int32 WorldSize);
+
+	void Reset();
+
+	TSharedPtr<const FMatrix> FindNoise(const uint64 Hash) const { return NoiseLayers.FindRef(Hash); }
+
+	// Replaces the cached layers with the ones used by the latest generation
+	void Store(TMap<uint64, TSharedPtr<const FMatrix>>&& InNoiseLayers);
+
+private:
+	FIntRect CachedRegion;
+	int32 CachedWorldSize = 0;
+
+	TMap<uint64, TSharedPtr<const FMatrix>> NoiseLayers;
+};
+
+struct FOctaveLayerCacheStats
+{
+	// Lookups over the lifetime of the cache
+	int64 Hits = 0;
+	int64 Misses = 0;
+	int64 Evictions = 0;
+	int32 NumLayers = 0;
+	int64 AllocatedBytes = 0;
+};
+
+/**
+ * Perlin octaves at unit amplitude, shared by every biome and generation that samples the same noise.
+ * An octave only depends on its offset, its frequency and the samples it covers, so biomes whose seeds
+ * and frequencies line up share layers, and a biome whose persistence or octave count changes keeps its
+ * octaves. A layer serves any region inside the one it was built for.
+ * The least recently used layers are dropped beyond the memory budget. Safe to use from any thread.
+ */
+template<typename ScalarType>
+class TOctaveLayerCache
+{
+public:
+	typedef THeightfield<ScalarType> FMatrix;
+
+	explicit TOctaveLayerCache(const int64 InMemoryBudget = 1024ll * 1024 * 1024) : MemoryBudget(InMemoryBudget) {}
+
+	// Layer that contains Region, OutOrigin is where Region starts in it. Counts a hit or a miss.
+	TSharedPtr<const FMatrix> Find(const FVector2D& Offset, const double Frequency, const FIntRect& Region, FIntPoint& OutOrigin);
+
+	// Layers larger than the whole budget are not kept
+	void Store(const FVector2D& Offset, const double Frequency, const FIntRect& Region, const TSharedPtr<const FMatrix>& Layer);
+
+	// False for octaves over Region that take more than a quarter of the budget. They would push most other
+	// layers out and be dropped again before anything reuses them, so they are generated without the cache.
+	bool ShouldCache(const FIntRect& Region) const;
+
+	void SetMemoryBudget(const int64 InMemoryBudget);
+
+	void Reset();
+
+	FOctaveLayerCacheStats GetStats() const;
+
+private:
+	struct FLayer
+	{
+		FVector2D Offset;
+		double Frequency = 0.0;
+		FIntRect Region;
+		TSharedPtr<const FMatrix> Samples;
+		uint64 LastUsed = 0;
+	};
+
+	// Drops the least recently used layers until they fit in the budget, the caller holds the lock
+	void Evict();
+
+	mutable FCriticalSection Lock;
+	TArray<FLayer> Layers;
+	int64 MemoryBudget;
+	uint64 UseCounter = 0;
+	FOctaveLayerCacheStats Stats;
+};
+
+/**
+ * Generates the blended biome heights for any region of the world.
+ * Everything is computed from global sample coordinates, so neighbouring regions line up exactly.
+ */
+template<typename ScalarType>
+class TTerrainGenerator
+{
+public:
+	typedef THeightfield<ScalarType> FMatrix;
+
+	TTerrainGenerator(const TArray<FBiome>& InBiomes, const int32 InWorldSize, const int32 InNumThreads = 0);
+
+	/**
+	 * Heights for Region, in world samples.
+	 * With a Cache, layers of unchanged biomes are reused and the new layers are stored in it.
+	 * Returns empty heights when the progress was cancelled, the cache is left as it was.
+	 */
+	FMatrix Generate(const FIntRect& Region, TTerrainLayerCache<ScalarType>* Cache = nullptr) const;
+
+	/**
+	 * Generates Size samples in full-width bands and hands each one to Sink.
+	 * Band height is chosen so the working set stays below MemoryBudget and is a multiple of RowAlignment.
+	 */
+	bool GenerateStreamed(const FIntPoint& Size, const int64 MemoryBudget, const int32 RowAlignment, TTerrainTileSink<ScalarType>& Sink) const;
+
+	int32 GetStreamingBandRows(const int32 Width, const int64 MemoryBudget, const int32 RowAlignment) const;
+
+	// BiomeIndex is only used to report progress
+	FMatrix GetNoiseMap(const FBiome& Biome, const FIntRect& Region, const int32 BiomeIndex = INDEX_NONE) const;
+
+	// 1 - Fade(distance to the biome center), how much of the biome is left at every sample of Region
+	Expr::FRadialFalloff GetFalloff(const FBiome& Biome, const FIntRect& Region) const;
+
+	/**
+	 * Part of Region, in world samples, where biome Index can get a blend weight of at least the weight epsilon.
+	 * Its noise is only generated and blended there.
+	 */
+	FIntRect GetBiomeSupport(const int32 Index, const FIntRect& Region) const;
+
+	/**
+	 * Adds biome Index to Heights, the first biome initializes it to the size of Region.
+	 * NoiseMap covers GetBiomeSupport(Index, Region). The falloffs are evaluated in the same pass,
+	 * so no distance or weight matrices are stored.
+	 */
+	void BlendBiome(FMatrix& Heights, const int32 Index, const FIntRect& Region, const FMatrix& NoiseMap) const;
+
+	// Biome origins are relative to the center of the world, the center is in samples of this generator
+	FVector2D GetBiomeCenter(const FBiome& Biome) const;
+
+	/**
+	 * Part of Region whose heights can differ from a generation with PreviousBiomes.
+	 * Biome weights are cut off where they drop far below a height step of Quantization, so a change
+	 * to a biome only dirties the area its falloff reaches.
+	 */
+	FIntRect GetChangedRegion(const TArray<FBiome>& PreviousBiomes, const FIntRect& Region, const FHeightQuantization& Quantization) const;
+
+	// Distance from the biome center beyond which 1 - Fade stays below Epsilon, MAX_dbl if it never does
+	static double GetFalloffRadius(const FBiome& Biome, const double Epsilon);
+
+	// Landscape heights are stored as uint16 around 32768
+	static FORCEINLINE uint16 QuantizeHeight(const ScalarType Height, const FHeightQuantization& Quantization = FHeightQuantization())
+	{
+		// Clamped before the conversion, so rows of them vectorize
+		const ScalarType Value = (Height - static_cast<ScalarType>(Quantization.Offset)) * static_cast<ScalarType>(Quantization.Scale) + static_cast<ScalarType>(32768);
+		return static_cast<uint16>(FMath::Min(FMath::Max(Value, static_cast<ScalarType>(0)), static_cast<ScalarType>(65535)));
+	}
+
+	static void QuantizeRow(const ScalarType* Heights, uint16* Out, const int32 Num, const FHeightQuantization& Quantization = FHeightQuantization());
+
+	/**
+	 * Quantizes Heights onto Size x Size samples, bands of rows in parallel. Without resampling the first
+	 * Size x Size heights are used, otherwise the whole heightfield is filtered onto the new grid with its
+	 * corners on the corners of Out.
+	 */
+	void Quantize(const FMatrix& Heights, const int32 Size, const EHeightResampling Resampling, const FHeightQuantization& Quantization, uint16* Out) const;
+
+	int32 GetNumBands(const int32 NumItems) const;
+
+	// Splits [0, NumItems) into contiguous bands and runs Body(Begin, End) for each of them in parallel
+	void ParallelForBands(const int32 NumItems, TFunctionRef<void(int32, int32)> Body) const;
+
+	// Every stage adds its time and heightfield allocations to Stats
+	void SetStats(FTerrainGenerationStats* InStats) { Stats = InStats; }
+
+	// Generate reports every octave and blend step to Progress, and returns empty heights once it is cancelled
+	void SetProgress(FTerrainGenerationProgress* InProgress) { Progress = InProgress; }
+
+	/**
+	 * Sample (x, y) of this generator is world sample (x * Stride, y * Stride), with the same noise
+	 * coordinates and falloffs. Regions are in these samples, so a stride of 4 covers the world with
+	 * a 16th of the samples.
+	 */
+	void SetSampleStride(const int32 InSampleStride) { SampleStride = FMath::Max(InSampleStride, 1); }
+
+	int32 GetSampleStride() const { return SampleStride; }
+
+	// Octaves are looked up in and stored to OctaveCache, which may be null. Biomes with gradient
+	// detail reduction need the derivatives of their octaves and always generate them, as do regions
+	// too large for the cache, see TOctaveLayerCache::ShouldCache.
+	void SetOctaveCache(TOctaveLayerCache<ScalarType>* InOctaveCache) { OctaveCache = InOctaveCache; }
+
+	// Blend weights below Epsilon are dropped along with the noise under them, 0 keeps every biome everywhere
+	void SetWeightEpsilon(const double InWeightEpsilon) { WeightEpsilon = InWeightEpsilon; }
+
+private:
+	FIntRect GetBiomeSupport(const TArray<FBiome>& InBiomes, const int32 Index, const FIntRect& Region) const;
+
+	// Samples of Region where 1 - Fade of Biome can reach Epsilon
+	FIntRect GetFalloffBounds(const FBiome& Biome, const double Epsilon, const FIntRect& Region) const;
+
+	// Unit amplitude octave over Region from the octave cache, or generated and stored in it. Null when cancelled.
+	TSharedPtr<const FMatrix> GetOctaveLayer(const FVector2D& Offset, const double Frequency, const FIntRect& Region, FIntPoint& OutOrigin) const;
+
+	TArray<FBiome> Biomes;
+	int32 WorldSize;
+	int32 NumThreads;
+	FTerrainGenerationStats* Stats = nullptr;
+	FTerrainGenerationProgress* Progress = nullptr;
+	TOctaveLayerCache<ScalarType>* OctaveCache = nullptr;
+	int32 SampleStride = 1;
+	double WeightEpsilon = 0.0;
+};
+
+extern template class TTerrainLayerCache<float>;
+extern template class TTerrainLayerCache<double>;
+extern template class TOctaveLayerCache<float>;
+extern template class TOctaveLayerCache<double>;
+extern template class TTerrainGenerator<float>;
+extern template class TTerrainGenerator<double>;
+
+// Types of the pipeline precision selected by AUTOWORLDGEN_DOUBLE_PRECISION
+typedef TTerrainLayerCache<VScalar> FTerrainLayerCache;
+typedef TOctaveLayerCache<VScalar> FOctaveLayerCache;
+typedef TTerrainGenerator<VScalar> FTerrainGenerator;
+
+// Largest difference between the quantized heights of the float and the double pipeline
+AUTOWORLDGEN_API int32 MeasurePrecisionError(const TArray<FBiome>& Biomes, const int32 WorldSize, const int32 NumThreads = 0);
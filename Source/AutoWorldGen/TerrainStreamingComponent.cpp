@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainStreamingComponent.h"
+
+#include "GameFramework/Pawn.h"
+#include "Kismet/GameplayStatics.h"
+#include "Materials/MaterialInterface.h"
+#include "ProceduralMeshComponent.h"
+
+UTerrainStreamingComponent::UTerrainStreamingComponent()
+{
+    PrimaryComponentTick.bCanEverTick = true;
+    PrimaryComponentTick.bStartWithTickEnabled = false;
+
+    CellQuads = 63;
+    ViewRadius = 6;
+    MaxCachedCells = 256;
+    MaxCellsInFlight = 8;
+    Material = nullptr;
+    bCreateCollision = true;
+}
+
+void UTerrainStreamingComponent::StartStreaming(const FTerrainCellSettings& Settings)
+{
+    StopStreaming();
+
+    FTerrainCellSettings CellSettings = Settings;
+    CellSettings.CellQuads = CellQuads;
+    CellCache = MakeUnique<FTerrainCellCache>(CellSettings);
+
+    ViewOffsets.Reset();
+    for (int32 y = -ViewRadius; y <= ViewRadius; y++)
+    {
+        for (int32 x = -ViewRadius; x <= ViewRadius; x++)
+        {
+            if (x * x + y * y <= ViewRadius * ViewRadius)
+            {
+                ViewOffsets.Add(FIntPoint(x, y));
+            }
+        }
+    }
+    ViewOffsets.Sort([](const FIntPoint& A, const FIntPoint& B)
+    {
+        return A.X * A.X + A.Y * A.Y < B.X * B.X + B.Y * B.Y;
+    });
+
+    SetComponentTickEnabled(true);
+}
+
+void UTerrainStreamingComponent::StopStreaming()
+{
+    SetComponentTickEnabled(false);
+
+    // Waits for the cells in flight
+    CellCache.Reset();
+
+    for (const TPair<FIntPoint, UProceduralMeshComponent*>& Pair : CellMeshes)
+    {
+        if (Pair.Value)
+        {
+            Pair.Value->DestroyComponent();
+        }
+    }
+    for (UProceduralMeshComponent* Mesh : FreeMeshes)
+    {
+        if (Mesh)
+        {
+            Mesh->DestroyComponent();
+        }
+    }
+    CellMeshes.Reset();
+    FreeMeshes.Reset();
+}
+
+void UTerrainStreamingComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    const APawn* Player = UGameplayStatics::GetPlayerPawn(this, 0);
+    if (!CellCache.IsValid() || !Player)
+    {
+        return;
+    }
+
+    CellCache->CollectFinished();
+    const FIntPoint PlayerCell = CellCache->GetCellAt(Player->GetActorLocation());
+
+    // Cells that left the view give their mesh back, their geometry stays in the cache
+    for (auto It = CellMeshes.CreateIterator(); It; ++It)
+    {
+        const FIntPoint Offset = It->Key - PlayerCell;
+        if (Offset.X * Offset.X + Offset.Y * Offset.Y > ViewRadius * ViewRadius)
+        {
+            It->Value->ClearAllMeshSections();
+            FreeMeshes.Add(It->Value);
+            It.RemoveCurrent();
+        }
+    }
+
+    // Nearest first, so the ground under the player is built before the horizon
+    for (const FIntPoint& Offset : ViewOffsets)
+    {
+        const FIntPoint Coord = PlayerCell + Offset;
+        const TSharedPtr<const FTerrainCell> Cell = CellCache->Find(Coord);
+        if (!Cell.IsValid())
+        {
+            CellCache->Request(Coord, MaxCellsInFlight);
+        }
+        else if (!CellMeshes.Contains(Coord))
+        {
+            ShowCell(*Cell);
+        }
+    }
+
+    // Cells in view were used just now and are never dropped
+    CellCache->Trim(FMath::Max(MaxCachedCells, ViewOffsets.Num()));
+}
+
+void UTerrainStreamingComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    StopStreaming();
+    Super::EndPlay(EndPlayReason);
+}
+
+void UTerrainStreamingComponent::ShowCell(const FTerrainCell& Cell)
+{
+    UProceduralMeshComponent* Mesh = FreeMeshes.Num() > 0 ? FreeMeshes.Pop() : nullptr;
+    if (!Mesh)
+    {
+        // Cell vertices are in world space
+        Mesh = NewObject<UProceduralMeshComponent>(GetOwner());
+        Mesh->SetUsingAbsoluteLocation(true);
+        Mesh->SetUsingAbsoluteRotation(true);
+        Mesh->SetUsingAbsoluteScale(true);
+        Mesh->bUseAsyncCooking = true;
+        Mesh->RegisterComponent();
+    }
+
+    Mesh->CreateMeshSection(0, Cell.Vertices, CellCache->GetTriangles(), Cell.Normals, Cell.UVs, TArray<FColor>(), TArray<FProcMeshTangent>(), bCreateCollision);
+    Mesh->SetMaterial(0, Material);
+    CellMeshes.Add(Cell.Coord, Mesh);
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "TerrainCellCache.h"
+
+#include "TerrainStreamingComponent.generated.h"
+
+class UMaterialInterface;
+class UProceduralMeshComponent;
+
+/**
+ * Shows terrain cells around the player's pawn while the game runs. Cells are built on worker threads
+ * from global sample coordinates, so the world has no edge and areas look the same when they are revisited.
+ * Landscapes can only be built in the editor, the cells are procedural meshes.
+ */
+UCLASS(ClassGroup = (AutoWorldGen), meta = (BlueprintSpawnableComponent))
+class AUTOWORLDGEN_API UTerrainStreamingComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTerrainStreamingComponent();
+
+	// Quads along each side of a cell
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Runtime", meta = (ClampMin = "1", ClampMax = "255"))
+	int32 CellQuads;
+
+	// Cells shown around the player's cell
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Runtime", meta = (ClampMin = "0"))
+	int32 ViewRadius;
+
+	// Cells kept after they leave the view, the least recently used ones are dropped first. Never fewer than the cells in view.
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Runtime", meta = (ClampMin = "0"))
+	int32 MaxCachedCells;
+
+	// Cells built on worker threads at the same time
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Runtime", meta = (ClampMin = "1"))
+	int32 MaxCellsInFlight;
+
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Runtime")
+	UMaterialInterface* Material;
+
+	UPROPERTY(EditAnywhere, Category = "AutoWorldGen|Runtime")
+	bool bCreateCollision;
+
+	// Replaces the cells of an earlier start, CellQuads is taken from this component
+	void StartStreaming(const FTerrainCellSettings& Settings);
+
+	void StopStreaming();
+
+	bool IsStreaming() const { return CellCache.IsValid(); }
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void ShowCell(const FTerrainCell& Cell);
+
+	TUniquePtr<FTerrainCellCache> CellCache;
+
+	// Offsets of the cells in view from the player's cell, nearest first
+	TArray<FIntPoint> ViewOffsets;
+
+	UPROPERTY(Transient)
+	TMap<FIntPoint, UProceduralMeshComponent*> CellMeshes;
+
+	// Meshes of cells that left the view, reused for the next ones
+	UPROPERTY(Transient)
+	TArray<UProceduralMeshComponent*> FreeMeshes;
+};
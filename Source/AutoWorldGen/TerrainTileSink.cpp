@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainTileSink.h"
+#include "TerrainGenerator.h"
+
+#include "HAL/PlatformFileManager.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "Misc/Paths.h"
+
+#if WITH_EDITOR
+#include "Landscape.h"
+#include "LandscapeEdit.h"
+#include "LandscapeInfo.h"
+#endif
+
+FRawHeightmapSink::FRawHeightmapSink(const FString& FilePath, const FIntPoint& InSize, const int64 InDataOffset)
+    : Size(InSize)
+    , DataOffset(InDataOffset)
+{
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    PlatformFile.CreateDirectoryTree(*FPaths::GetPath(FilePath));
+    File.Reset(PlatformFile.OpenWrite(*FilePath));
+
+    if (!File.IsValid())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Failed to open %s for writing."), *FilePath);
+    }
+}
+
+FRawHeightmapSink::~FRawHeightmapSink()
+{
+    if (File.IsValid())
+    {
+        File->Flush();
+    }
+}
+
+bool FRawHeightmapSink::WriteTile(const FIntRect& Region, const VMatrix& Heights)
+{
+    if (!File.IsValid() || Heights.GetWidth() != Region.Width() || Heights.GetHeight() != Region.Height())
+    {
+        return false;
+    }
+
+    RowBuffer.SetNumUninitialized(Region.Width());
+    for (int32 y = 0; y < Region.Height(); y++)
+    {
+        FTerrainGenerator::QuantizeRow(Heights.GetRowData(y), RowBuffer.GetData(), Region.Width(), Quantization);
+        if (!WriteRow(Region.Min.X, Region.Min.Y + y, RowBuffer.GetData(), RowBuffer.Num()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FRawHeightmapSink::WriteSamples(const FIntRect& Region, const uint16* Samples)
+{
+    if (!File.IsValid())
+    {
+        return false;
+    }
+
+    for (int32 y = 0; y < Region.Height(); y++)
+    {
+        if (!WriteRow(Region.Min.X, Region.Min.Y + y, Samples + static_cast<int64>(y) * Region.Width(), Region.Width()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FRawHeightmapSink::WriteRow(const int32 X, const int32 Y, const uint16* Samples, const int32 Num)
+{
+    const int64 Offset = DataOffset + (static_cast<int64>(Y) * Size.X + X) * sizeof(uint16);
+    return File->Seek(Offset) && File->Write(reinterpret_cast<const uint8*>(Samples), Num * sizeof(uint16));
+}
+
+#if WITH_EDITOR
+FLandscapeHeightSink::FLandscapeHeightSink(ALandscape* InLandscape, const FIntPoint& InOffset)
+    : Landscape(InLandscape)
+    , Offset(InOffset)
+{
+}
+
+bool FLandscapeHeightSink::WriteTile(const FIntRect& Region, const VMatrix& Heights)
+{
+    ULandscapeInfo* LandscapeInfo = Landscape ? Landscape->GetLandscapeInfo() : nullptr;
+    if (!LandscapeInfo)
+    {
+        return false;
+    }
+
+    TArray<uint16> HeightData;
+    HeightData.SetNumUninitialized(Region.Width() * Region.Height());
+    for (int32 y = 0; y < Region.Height(); y++)
+    {
+        FTerrainGenerator::QuantizeRow(Heights.GetRowData(y), HeightData.GetData() + y * Region.Width(), Region.Width(), Quantization);
+    }
+
+    // Heights go into the base edit layer, the same one Import filled
+    const FLandscapeLayer* BaseLayer = Landscape->HasLayersContent() ? Landscape->GetLayerConst(0) : nullptr;
+    FScopedSetLandscapeEditingLayer EditingLayer(Landscape, BaseLayer ? BaseLayer->Guid : FGuid());
+
+    FLandscapeEditDataInterface LandscapeEdit(LandscapeInfo);
+    LandscapeEdit.SetHeightData(
+        Offset.X + Region.Min.X,
+        Offset.Y + Region.Min.Y,
+        Offset.X + Region.Max.X - 1,
+        Offset.Y + Region.Max.Y - 1,
+        HeightData.GetData(),
+        Region.Width(),
+        true
+    );
+    LandscapeEdit.Flush();
+
+    return true;
+}
+#endif
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VaribleMatrix.h"
+#include "HeightQuantization.h"
+
+using namespace VaribleMatrix;
+
+class IFileHandle;
+class ALandscape;
+
+/**
+ * Receives finished parts of the heightmap while the terrain is generated in bands.
+ */
+template<typename ScalarType>
+class TTerrainTileSink
+{
+public:
+	virtual ~TTerrainTileSink() = default;
+
+	// Region is in heightmap samples and Heights holds exactly the samples of Region
+	virtual bool WriteTile(const FIntRect& Region, const THeightfield<ScalarType>& Heights) = 0;
+};
+
+typedef TTerrainTileSink<VScalar> ITerrainTileSink;
+
+/**
+ * Writes a headerless little-endian 16 bit heightmap (.r16), the raw format the landscape import reads.
+ * The samples start at DataOffset, so derived formats can put a header in front of them.
+ */
+class AUTOWORLDGEN_API FRawHeightmapSink : public ITerrainTileSink
+{
+public:
+	FRawHeightmapSink(const FString& FilePath, const FIntPoint& InSize, const int64 InDataOffset = 0);
+	virtual ~FRawHeightmapSink();
+
+	bool IsValid() const { return File.IsValid(); }
+
+	virtual bool WriteTile(const FIntRect& Region, const VMatrix& Heights) override;
+
+	// Samples are already quantized and hold the rows of Region back to back
+	bool WriteSamples(const FIntRect& Region, const uint16* Samples);
+
+	void SetQuantization(const FHeightQuantization& InQuantization) { Quantization = InQuantization; }
+
+protected:
+	bool WriteRow(const int32 X, const int32 Y, const uint16* Samples, const int32 Num);
+
+	TUniquePtr<IFileHandle> File;
+	FIntPoint Size;
+	int64 DataOffset;
+	FHeightQuantization Quantization;
+	TArray<uint16> RowBuffer;
+};
+
+#if WITH_EDITOR
+/**
+ * Writes heights straight into an existing landscape through the landscape edit interface.
+ */
+class AUTOWORLDGEN_API FLandscapeHeightSink : public ITerrainTileSink
+{
+public:
+	// Offset is the landscape coordinate of heightmap sample (0, 0)
+	FLandscapeHeightSink(ALandscape* InLandscape, const FIntPoint& InOffset);
+
+	virtual bool WriteTile(const FIntRect& Region, const VMatrix& Heights) override;
+
+	// Has to match the quantization the landscape was imported with
+	void SetQuantization(const FHeightQuantization& InQuantization) { Quantization = InQuantization; }
+
+private:
+	ALandscape* Landscape;
+	FIntPoint Offset;
+	FHeightQuantization Quantization;
+};
+#endif
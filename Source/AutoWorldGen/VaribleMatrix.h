@@ -3,28 +3,338 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Heightfield.h"
+
+#include <type_traits>
+
+// The generation pipeline runs in float unless the module is built with double precision.
+// Heights end up as 16 bit landscape samples, so float keeps well below one height step.
+#ifndef AUTOWORLDGEN_DOUBLE_PRECISION
+#define AUTOWORLDGEN_DOUBLE_PRECISION 0
+#endif
 
 /**
- * 
+ * Element-wise matrix arithmetic.
+ * Add, Subtract, Multiply, Divide, Fade and RadialFalloff build lazy expressions; nothing is computed until the
+ * expression is converted to a heightfield or passed to Assign/AddInPlace/MulInPlace, and then the
+ * whole expression is evaluated in a single pass without temporaries.
+ * Expressions keep references to lvalue matrices, so evaluate them within the statement that built them.
  */
 namespace VaribleMatrix
 {
-	typedef TArray<TArray<double>> VMatrix;
+#if AUTOWORLDGEN_DOUBLE_PRECISION
+	typedef double VScalar;
+#else
+	typedef float VScalar;
+#endif
 
-	VMatrix Create(const uint16 Size, const double Value = 0.0);
+	typedef THeightfield<VScalar> VMatrix;
 
-	VMatrix Add(const VMatrix& A, const VMatrix& B);
-	VMatrix Add(const double A, const VMatrix& B);
+	// Legacy layout, convert with VMatrix::FromJagged / ToJagged
+	typedef TArray<TArray<double>> VJaggedMatrix;
 
-	VMatrix Subtract(const VMatrix& A, const VMatrix& B);
-	VMatrix Subtract(const double A, const VMatrix& B);
+	VMatrix Create(const int32 Size, const double Value = 0.0);
 
-	VMatrix Multiply(const VMatrix& A, const VMatrix& B);
-	VMatrix Multiply(const double A, const VMatrix& B);
+	template<typename Derived>
+	struct TExpression
+	{
+		FORCEINLINE const Derived& Self() const { return static_cast<const Derived&>(*this); }
 
-	VMatrix Divide(const VMatrix& A, const VMatrix& B);
-	VMatrix Divide(const double A, const VMatrix& B);
+		// Evaluates into a heightfield of any precision
+		template<typename ScalarType>
+		operator THeightfield<ScalarType>() const;
+	};
 
-	VMatrix Fade(const VMatrix& x, const double a = 2, const double s = 0, const double k = 1);
-}
+	namespace Expr
+	{
+		// Size.X == INDEX_NONE means the operand does not constrain the size yet
+		FORCEINLINE bool MergeSize(FIntPoint& Size, const int32 Width, const int32 Height)
+		{
+			if (Size.X == INDEX_NONE)
+			{
+				Size = FIntPoint(Width, Height);
+				return true;
+			}
+			return Size.X == Width && Size.Y == Height;
+		}
+
+		struct FScalar : TExpression<FScalar>
+		{
+			double Value;
+
+			explicit FScalar(const double InValue) : Value(InValue) {}
+
+			template<typename T>
+			FORCEINLINE T Get(const int32 Y, const int32 X) const { return static_cast<T>(Value); }
+			FORCEINLINE bool CollectSize(FIntPoint& Size) const { return true; }
+		};
+
+		template<typename ScalarType>
+		struct TMatrixRef : TExpression<TMatrixRef<ScalarType>>
+		{
+			const THeightfield<ScalarType>& Matrix;
+
+			explicit TMatrixRef(const THeightfield<ScalarType>& InMatrix) : Matrix(InMatrix) {}
+
+			template<typename T>
+			FORCEINLINE T Get(const int32 Y, const int32 X) const { return static_cast<T>(Matrix.GetRowData(Y)[X]); }
+			FORCEINLINE bool CollectSize(FIntPoint& Size) const { return MergeSize(Size, Matrix.GetWidth(), Matrix.GetHeight()); }
+		};
+
+		// Takes ownership of temporaries so they outlive the expression that uses them
+		template<typename ScalarType>
+		struct TMatrixOwned : TExpression<TMatrixOwned<ScalarType>>
+		{
+			THeightfield<ScalarType> Matrix;
+
+			explicit TMatrixOwned(THeightfield<ScalarType>&& InMatrix) : Matrix(MoveTemp(InMatrix)) {}
+
+			template<typename T>
+			FORCEINLINE T Get(const int32 Y, const int32 X) const { return static_cast<T>(Matrix.GetRowData(Y)[X]); }
+			FORCEINLINE bool CollectSize(FIntPoint& Size) const { return MergeSize(Size, Matrix.GetWidth(), Matrix.GetHeight()); }
+		};
+
+		FORCEINLINE FScalar MakeOperand(const double Value) { return FScalar(Value); }
+
+		template<typename ScalarType>
+		FORCEINLINE TMatrixRef<ScalarType> MakeOperand(const THeightfield<ScalarType>& Matrix) { return TMatrixRef<ScalarType>(Matrix); }
+
+		template<typename ScalarType>
+		FORCEINLINE TMatrixOwned<ScalarType> MakeOperand(THeightfield<ScalarType>&& Matrix) { return TMatrixOwned<ScalarType>(MoveTemp(Matrix)); }
+
+		template<typename Derived>
+		FORCEINLINE const Derived& MakeOperand(const TExpression<Derived>& Expression) { return Expression.Self(); }
+
+		template<typename Derived>
+		FORCEINLINE Derived&& MakeOperand(TExpression<Derived>&& Expression) { return static_cast<Derived&&>(Expression); }
+
+		template<typename T>
+		using TOperand = std::decay_t<decltype(MakeOperand(DeclVal<T>()))>;
+
+		struct FAddOp { template<typename T> static FORCEINLINE T Apply(const T A, const T B) { return A + B; } };
+		struct FSubtractOp { template<typename T> static FORCEINLINE T Apply(const T A, const T B) { return A - B; } };
+		struct FMultiplyOp { template<typename T> static FORCEINLINE T Apply(const T A, const T B) { return A * B; } };
+		// Division by zero yields zero
+		struct FDivideOp { template<typename T> static FORCEINLINE T Apply(const T A, const T B) { return B != 0 ? A / B : T(0); } };
+
+		template<typename OpType, typename LhsType, typename RhsType>
+		struct TBinary : TExpression<TBinary<OpType, LhsType, RhsType>>
+		{
+			LhsType Lhs;
+			RhsType Rhs;
+
+			template<typename A, typename B>
+			TBinary(A&& InLhs, B&& InRhs) : Lhs(Forward<A>(InLhs)), Rhs(Forward<B>(InRhs)) {}
+
+			template<typename T>
+			FORCEINLINE T Get(const int32 Y, const int32 X) const { return OpType::Apply(Lhs.template Get<T>(Y, X), Rhs.template Get<T>(Y, X)); }
+			FORCEINLINE bool CollectSize(FIntPoint& Size) const { return Lhs.CollectSize(Size) && Rhs.CollectSize(Size); }
+		};
+
+		template<typename OperandType>
+		struct TFade : TExpression<TFade<OperandType>>
+		{
+			OperandType Operand;
+			double Log2a;
+			double _k;
+			double ks;
+
+			template<typename A>
+			TFade(A&& InOperand, const double Ina, const double s, const double k)
+				: Operand(Forward<A>(InOperand))
+				// Precompute constants outside the loops
+				, Log2a(FMath::Log2(Ina))
+				, _k(-1 / k)
+				, ks(s) // k * s * 1 / k
+			{
+			}
+
+			template<typename T>
+			FORCEINLINE T Get(const int32 Y, const int32 X) const
+			{
+				// a^y == 2^(y * log2(a))
+				return T(1) / (T(1) + FMath::Exp2(static_cast<T>(Log2a) * (static_cast<T>(_k) * Operand.template Get<T>(Y, X) + static_cast<T>(ks))));
+			}
+			FORCEINLINE bool CollectSize(FIntPoint& Size) const { return Operand.CollectSize(Size); }
+		};
+
+		// 1 - Fade(distance to Center), evaluated per sample so no distance matrix is ever stored
+		struct FRadialFalloff : TExpression<FRadialFalloff>
+		{
+			// Center in the coordinates of the matrices the falloff is combined with
+			double CenterX;
+			double CenterY;
+			// 1 - 1 / (1 + a^(s - d / k)) == 1 / (1 + 2^(Scale * d + Bias))
+			double Scale;
+			double Bias;
 
+			FRadialFalloff(const FVector2D Center, const double a, const double s, const double k)
+				: CenterX(Center.X)
+				, CenterY(Center.Y)
+				, Scale(FMath::Log2(a) / k)
+				, Bias(-FMath::Log2(a) * s)
+			{
+			}
+
+			template<typename T>
+			FORCEINLINE T Get(const int32 Y, const int32 X) const
+			{
+				const T Dx = static_cast<T>(X) - static_cast<T>(CenterX);
+				const T Dy = static_cast<T>(Y) - static_cast<T>(CenterY);
+				return T(1) / (T(1) + FMath::Exp2(static_cast<T>(Scale) * FMath::Sqrt(Dx * Dx + Dy * Dy) + static_cast<T>(Bias)));
+			}
+			FORCEINLINE bool CollectSize(FIntPoint& Size) const { return true; }
+		};
+
+		template<typename OpType, typename A, typename B>
+		using TBinaryOf = TBinary<OpType, TOperand<A>, TOperand<B>>;
+
+		template<typename Derived>
+		FORCEINLINE bool GetSize(const TExpression<Derived>& Expression, FIntPoint& OutSize)
+		{
+			OutSize = FIntPoint(INDEX_NONE, INDEX_NONE);
+			if (!Expression.Self().CollectSize(OutSize))
+			{
+				UE_LOG(LogTemp, Error, TEXT("Matrices must have the same dimensions."));
+				return false;
+			}
+			return true;
+		}
+
+		// The expression is evaluated in the precision of Out, over the samples of Rect
+		template<typename ScalarType, typename Derived, typename CombineType>
+		void EvaluateInto(THeightfield<ScalarType>& Out, const FIntRect& Rect, const TExpression<Derived>& Expression, CombineType Combine)
+		{
+			const Derived& E = Expression.Self();
+			const int32 Rows = Rect.Height();
+			const int32 Cols = Rect.Width();
+
+			for (int32 i = 0; i < Rows; ++i)
+			{
+				ScalarType* RowOut = Out.GetRowData(Rect.Min.Y + i) + Rect.Min.X;
+				for (int32 j = 0; j < Cols; ++j)
+				{
+					RowOut[j] = Combine(RowOut[j], E.template Get<ScalarType>(i, j));
+				}
+			}
+		}
+	}
+
+	template<typename A, typename B>
+	FORCEINLINE Expr::TBinaryOf<Expr::FAddOp, A, B> Add(A&& Lhs, B&& Rhs)
+	{
+		return Expr::TBinaryOf<Expr::FAddOp, A, B>(Expr::MakeOperand(Forward<A>(Lhs)), Expr::MakeOperand(Forward<B>(Rhs)));
+	}
+
+	template<typename A, typename B>
+	FORCEINLINE Expr::TBinaryOf<Expr::FSubtractOp, A, B> Subtract(A&& Lhs, B&& Rhs)
+	{
+		return Expr::TBinaryOf<Expr::FSubtractOp, A, B>(Expr::MakeOperand(Forward<A>(Lhs)), Expr::MakeOperand(Forward<B>(Rhs)));
+	}
+
+	template<typename A, typename B>
+	FORCEINLINE Expr::TBinaryOf<Expr::FMultiplyOp, A, B> Multiply(A&& Lhs, B&& Rhs)
+	{
+		return Expr::TBinaryOf<Expr::FMultiplyOp, A, B>(Expr::MakeOperand(Forward<A>(Lhs)), Expr::MakeOperand(Forward<B>(Rhs)));
+	}
+
+	template<typename A, typename B>
+	FORCEINLINE Expr::TBinaryOf<Expr::FDivideOp, A, B> Divide(A&& Lhs, B&& Rhs)
+	{
+		return Expr::TBinaryOf<Expr::FDivideOp, A, B>(Expr::MakeOperand(Forward<A>(Lhs)), Expr::MakeOperand(Forward<B>(Rhs)));
+	}
+
+	template<typename A>
+	FORCEINLINE Expr::TFade<Expr::TOperand<A>> Fade(A&& x, const double a = 2, const double s = 0, const double k = 1)
+	{
+		return Expr::TFade<Expr::TOperand<A>>(Expr::MakeOperand(Forward<A>(x)), a, s, k);
+	}
+
+	// 1 - Fade(distance to Center, a, s, k), Center given in matrix coordinates
+	FORCEINLINE Expr::FRadialFalloff RadialFalloff(const FVector2D Center, const double a = 2, const double s = 0, const double k = 1)
+	{
+		return Expr::FRadialFalloff(Center, a, s, k);
+	}
+
+	// Evaluates the expression into Out, resizing it when needed. Out may appear in the expression.
+	template<typename ScalarType, typename A>
+	void Assign(THeightfield<ScalarType>& Out, A&& Value)
+	{
+		const auto& Operand = Expr::MakeOperand(Forward<A>(Value));
+
+		FIntPoint Size;
+		if (!Expr::GetSize(Operand, Size))
+		{
+			Out.Reset();
+			return;
+		}
+		if (Size.X == INDEX_NONE)
+		{
+			// A plain scalar keeps the current size
+			Size = FIntPoint(Out.GetWidth(), Out.GetHeight());
+		}
+		if (Out.GetWidth() != Size.X || Out.GetHeight() != Size.Y)
+		{
+			Out.Init(Size.X, Size.Y);
+		}
+
+		Expr::EvaluateInto(Out, FIntRect(0, 0, Size.X, Size.Y), Operand, [](const ScalarType, const ScalarType V) { return V; });
+	}
+
+	// Out += Value
+	template<typename ScalarType, typename A>
+	void AddInPlace(THeightfield<ScalarType>& Out, A&& Value)
+	{
+		const auto& Operand = Expr::MakeOperand(Forward<A>(Value));
+
+		FIntPoint Size(Out.GetWidth(), Out.GetHeight());
+		if (!Operand.CollectSize(Size))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Matrices must have the same dimensions."));
+			return;
+		}
+
+		Expr::EvaluateInto(Out, FIntRect(0, 0, Size.X, Size.Y), Operand, [](const ScalarType O, const ScalarType V) { return O + V; });
+	}
+
+	// Out += Value over Rect of Out only, Value has the size of Rect
+	template<typename ScalarType, typename A>
+	void AddInPlace(THeightfield<ScalarType>& Out, const FIntRect& Rect, A&& Value)
+	{
+		const auto& Operand = Expr::MakeOperand(Forward<A>(Value));
+
+		FIntPoint Size(Rect.Width(), Rect.Height());
+		if (Rect.Min.X < 0 || Rect.Min.Y < 0 || Rect.Max.X > Out.GetWidth() || Rect.Max.Y > Out.GetHeight() || !Operand.CollectSize(Size))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Matrices must have the same dimensions."));
+			return;
+		}
+
+		Expr::EvaluateInto(Out, Rect, Operand, [](const ScalarType O, const ScalarType V) { return O + V; });
+	}
+
+	// Out *= Value
+	template<typename ScalarType, typename A>
+	void MulInPlace(THeightfield<ScalarType>& Out, A&& Value)
+	{
+		const auto& Operand = Expr::MakeOperand(Forward<A>(Value));
+
+		FIntPoint Size(Out.GetWidth(), Out.GetHeight());
+		if (!Operand.CollectSize(Size))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Matrices must have the same dimensions."));
+			return;
+		}
+
+		Expr::EvaluateInto(Out, FIntRect(0, 0, Size.X, Size.Y), Operand, [](const ScalarType O, const ScalarType V) { return O * V; });
+	}
+
+	template<typename Derived>
+	template<typename ScalarType>
+	TExpression<Derived>::operator THeightfield<ScalarType>() const
+	{
+		THeightfield<ScalarType> Result;
+		Assign(Result, Self());
+		return Result;
+	}
+}